@@ -12,6 +12,8 @@
 #include <libsecret/secret.h>
 
 #include "applet-agent.h"
+#include "applet-secret-cache.h"
+#include "applet-trace.h"
 #include "utils.h"
 
 #define KEYRING_UUID_TAG "connection-uuid"
@@ -35,8 +37,27 @@ G_DEFINE_TYPE (AppletAgent, applet_agent, NM_TYPE_SECRET_AGENT_OLD);
 
 typedef struct {
 	GHashTable *requests;
+	/* GetSecrets requests by "<connection path>/<setting name>" (GPtrArray) */
+	GHashTable *get_requests;
 	gboolean vpn_only;
 
+	AppletHistogram keyring_time;
+	AppletHistogram save_time;
+	/* connection type -> AppletHistogram[APPLET_AGENT_STAGE_LAST + 1] */
+	GHashTable *stage_times;
+	guint64 saves_skipped;
+	guint64 requests_coalesced;
+	AppletSecretCache *secret_cache;
+	guint save_concurrency;
+
+	SecretService *secret_service;
+	GCancellable *secret_service_cancellable;
+	/* The collections whose locking drops the secret cache */
+	GPtrArray *watched_collections;
+	gint64 start_time;
+	gint64 secret_service_open_time;
+	gint64 first_secret_time;
+
 	gboolean disposed;
 } AppletAgentPrivate;
 
@@ -47,6 +68,14 @@ enum {
 };
 static guint signals[LAST_SIGNAL] = { 0 };
 
+static const char *const stage_names[APPLET_AGENT_STAGE_LAST + 1] = {
+	[APPLET_AGENT_STAGE_KEYRING]     = "keyring-search",
+	[APPLET_AGENT_STAGE_DIALOG_WAIT] = "dialog-wait",
+	[APPLET_AGENT_STAGE_USER]        = "user",
+	[APPLET_AGENT_STAGE_AUTH_DIALOG] = "auth-dialog",
+	[APPLET_AGENT_STAGE_REPLY]       = "reply",
+};
+
 
 /*******************************************************/
 
@@ -66,8 +95,88 @@ typedef struct {
 
 	GCancellable *cancellable;
 	gint keyring_calls;
+
+	gint64 arrival_time;
+	gint64 keyring_start_time;
+
+	/* For the secret cache; only set for GetSecrets requests it may serve */
+	char *fingerprint;
+
+	/* SaveSecrets: the SaveItems not yet written to the keyring */
+	GQueue *save_queue;
+	gint64 save_start_time;
+
+	/* GetSecrets: identical requests that arrived while this one was in
+	 * flight, and are completed along with it (Waiter) */
+	GSList *waiters;
+
+	/* GetSecrets: the key in get_requests */
+	char *index_key;
 } Request;
 
+typedef struct {
+	NMConnection *connection;
+	NMSecretAgentOldGetSecretsFunc callback;
+	gpointer callback_data;
+} Waiter;
+
+typedef struct {
+	Request *r;
+	GHashTable *attrs;
+	char *display_name;
+	char *secret;
+	gint64 start_time;
+} SaveItem;
+
+static void
+waiter_free (gpointer data)
+{
+	Waiter *w = data;
+
+	g_object_unref (w->connection);
+	g_slice_free (Waiter, w);
+}
+
+static void
+save_item_free (gpointer data)
+{
+	SaveItem *item = data;
+
+	g_hash_table_unref (item->attrs);
+	g_free (item->display_name);
+	nm_free_secret (item->secret);
+	g_slice_free (SaveItem, item);
+}
+
+static void
+request_keyring_call_done_since (Request *r, gint64 start_time)
+{
+	r->keyring_calls--;
+
+	/* The agent may already be gone if the request was canceled */
+	if (!g_cancellable_is_cancelled (r->cancellable)) {
+		applet_histogram_add (&APPLET_AGENT_GET_PRIVATE (r->agent)->keyring_time,
+		                      g_get_monotonic_time () - start_time);
+	}
+}
+
+static void
+request_keyring_call_done (Request *r)
+{
+	request_keyring_call_done_since (r, r->keyring_start_time);
+}
+
+static const char *
+request_get_trace_name (Request *r)
+{
+	if (r->get_callback)
+		return "get-secrets";
+	else if (r->save_callback)
+		return "save-secrets";
+	else
+		return "delete-secrets";
+}
+
 static Request *
 request_new (NMSecretAgentOld *agent,
              NMConnection *connection,
@@ -97,27 +206,135 @@ request_new (NMSecretAgentOld *agent,
 	r->delete_callback = delete_callback;
 	r->callback_data = callback_data;
 	r->cancellable = g_cancellable_new ();
+	r->arrival_time = g_get_monotonic_time ();
+
+	applet_trace_async_begin ("agent", request_get_trace_name (r), GUINT_TO_POINTER (r->id));
 	return r;
 }
 
+static char *
+request_index_key (const char *connection_path, const char *setting_name)
+{
+	return g_strdup_printf ("%s/%s", connection_path, setting_name);
+}
+
+static void
+request_index_add (AppletAgentPrivate *priv, Request *r)
+{
+	GPtrArray *array;
+
+	r->index_key = request_index_key (r->path, r->setting_name);
+	array = g_hash_table_lookup (priv->get_requests, r->index_key);
+	if (!array) {
+		array = g_ptr_array_new ();
+		g_hash_table_insert (priv->get_requests, g_strdup (r->index_key), array);
+	}
+	g_ptr_array_add (array, r);
+}
+
+static void
+request_index_remove (AppletAgentPrivate *priv, Request *r)
+{
+	GPtrArray *array;
+
+	array = g_hash_table_lookup (priv->get_requests, r->index_key);
+	if (array) {
+		g_ptr_array_remove_fast (array, r);
+		if (array->len == 0)
+			g_hash_table_remove (priv->get_requests, r->index_key);
+	}
+}
+
 static void
 request_free (Request *r)
 {
-	if (!g_cancellable_is_cancelled (r->cancellable))
-		g_hash_table_remove (APPLET_AGENT_GET_PRIVATE (r->agent)->requests, GUINT_TO_POINTER (r->id));
+	if (!g_cancellable_is_cancelled (r->cancellable)) {
+		AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (r->agent);
+
+		g_hash_table_remove (priv->requests, GUINT_TO_POINTER (r->id));
+		if (r->index_key)
+			request_index_remove (priv, r);
+	}
 
 	/* By the time the request is freed, all keyring calls should be completed */
 	g_warn_if_fail (r->keyring_calls == 0);
 
+	applet_trace_async_end ("agent", request_get_trace_name (r), GUINT_TO_POINTER (r->id));
+
 	g_object_unref (r->connection);
 	g_free (r->path);
 	g_free (r->setting_name);
 	g_strfreev (r->hints);
+	g_free (r->fingerprint);
+	g_free (r->index_key);
+	if (r->save_queue)
+		g_queue_free_full (r->save_queue, save_item_free);
+	/* Only left if the request was canceled */
+	g_slist_free_full (r->waiters, waiter_free);
 	g_object_unref (r->cancellable);
 	memset (r, 0, sizeof (*r));
 	g_slice_free (Request, r);
 }
 
+/* Calls the GetSecrets callback of the request and of everyone waiting on it */
+static void
+request_complete_get (Request *r, GVariant *secrets, GError *error)
+{
+	GSList *waiters = g_slist_reverse (r->waiters);
+	GSList *iter;
+
+	r->waiters = NULL;
+	applet_agent_add_stage_time (APPLET_AGENT (r->agent), r->connection, APPLET_AGENT_STAGE_REPLY,
+	                             r->arrival_time, g_get_monotonic_time ());
+	r->get_callback (NM_SECRET_AGENT_OLD (r->agent), r->connection, secrets, error, r->callback_data);
+
+	for (iter = waiters; iter; iter = iter->next) {
+		Waiter *w = iter->data;
+
+		w->callback (NM_SECRET_AGENT_OLD (r->agent), w->connection, secrets, error, w->callback_data);
+	}
+	g_slist_free_full (waiters, waiter_free);
+}
+
+static gboolean
+hints_equal (char **a, const char **b)
+{
+	guint i;
+
+	if (!a || !b)
+		return (!a || !a[0]) && (!b || !b[0]);
+
+	for (i = 0; a[i] && b[i]; i++) {
+		if (strcmp (a[i], b[i]))
+			return FALSE;
+	}
+	return !a[i] && !b[i];
+}
+
+/* Finds an in-flight GetSecrets request that a new one can wait on */
+static Request *
+request_find_identical (AppletAgentPrivate *priv,
+                        const char *connection_path,
+                        const char *setting_name,
+                        const char **hints,
+                        guint32 flags)
+{
+	gs_free char *key = request_index_key (connection_path, setting_name);
+	GPtrArray *array;
+	Request *r;
+	guint i;
+
+	array = g_hash_table_lookup (priv->get_requests, key);
+	for (i = 0; array && i < array->len; i++) {
+		r = array->pdata[i];
+		if (   !g_cancellable_is_cancelled (r->cancellable)
+		    && r->flags == flags
+		    && hints_equal (r->hints, hints))
+			return r;
+	}
+	return NULL;
+}
+
 /*******************************************************/
 
 static void
@@ -164,14 +381,18 @@ get_secrets_cb (AppletAgent *self,
 			g_object_unref (dupl);
 		}
 
-		r->get_callback (NM_SECRET_AGENT_OLD (r->agent), r->connection, secrets, error, r->callback_data);
+		request_complete_get (r, secrets, error);
 	}
 	request_free (r);
 }
 
+/* @existing_secrets are the secrets of r->setting_name found in the keyring,
+ * or %NULL if the keyring wasn't searched. */
 static void
-ask_for_secrets (Request *r)
+ask_for_secrets (Request *r, GVariant *existing_secrets)
 {
+	applet_trace_instant ("agent", "ask-for-secrets");
+
 	/* Ask the applet to get some secrets for us */
 	g_signal_emit (r->agent,
 	               signals[GET_SECRETS],
@@ -181,6 +402,7 @@ ask_for_secrets (Request *r)
 	               r->setting_name,
 	               r->hints,
 	               r->flags,
+	               existing_secrets,
 	               get_secrets_cb,
 	               r);
 }
@@ -254,23 +476,66 @@ is_connection_always_ask (NMConnection *connection)
 	return FALSE;
 }
 
+static void
+get_secrets_complete (Request *r, GVariant *setting_secrets, gboolean hint_found)
+{
+	const char *connection_id = nm_connection_get_id (r->connection);
+	GVariantBuilder builder_connection;
+	GVariant *settings;
+	gboolean ask = FALSE;
+
+	/* If there were hints, and none of the hints were returned by the keyring,
+	 * get some new secrets.
+	 */
+	if (r->flags) {
+		if (r->hints && r->hints[0] && !hint_found)
+			ask = TRUE;
+		else if (r->flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_REQUEST_NEW) {
+			g_message ("New secrets for %s/%s requested; ask the user", connection_id, r->setting_name);
+			ask = TRUE;
+		} else if (   (r->flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_ALLOW_INTERACTION)
+			       && is_connection_always_ask (r->connection))
+			ask = TRUE;
+	}
+
+	/* Returned secrets are a{sa{sv}}; this is the outer a{s...} hash that
+	 * will contain all the individual settings hashes.
+	 */
+	g_variant_builder_init (&builder_connection, NM_VARIANT_TYPE_CONNECTION);
+	g_variant_builder_add (&builder_connection, "{s@a{sv}}", r->setting_name, setting_secrets);
+	settings = g_variant_ref_sink (g_variant_builder_end (&builder_connection));
+
+	if (ask) {
+		/* Stuff all the found secrets into the connection for the UI to use */
+		nm_connection_update_secrets (r->connection, r->setting_name, setting_secrets, NULL);
+		ask_for_secrets (r, setting_secrets);
+	} else {
+		/* Otherwise send the secrets back to NetworkManager */
+		request_complete_get (r, settings, NULL);
+		request_free (r);
+	}
+
+	g_variant_unref (settings);
+}
+
 static void
 keyring_find_secrets_cb (GObject *source,
                          GAsyncResult *result,
                          gpointer user_data)
 {
 	Request *r = user_data;
+	AppletAgentPrivate *priv;
 	GError *error = NULL;
 	GError *search_error = NULL;
 	const char *connection_id = NULL;
-	GVariantBuilder builder_setting, builder_connection;
+	GVariantBuilder builder_setting;
 	GVariantBuilder *wg_peers_builder = NULL;
-	GVariant *settings = NULL;
+	GVariant *setting_secrets;
 	GList *list = NULL;
 	GList *iter;
-	gboolean hint_found = FALSE, ask = FALSE;
+	gboolean hint_found = FALSE;
 
-	r->keyring_calls--;
+	request_keyring_call_done (r);
 	if (g_cancellable_is_cancelled (r->cancellable)) {
 		/* Callback already called by NM or dispose */
 		request_free (r);
@@ -278,6 +543,14 @@ keyring_find_secrets_cb (GObject *source,
 	}
 
 	list = secret_service_search_finish (NULL, result, &search_error);
+	applet_agent_add_stage_time (APPLET_AGENT (r->agent), r->connection, APPLET_AGENT_STAGE_KEYRING,
+	                             r->keyring_start_time, g_get_monotonic_time ());
+
+	priv = APPLET_AGENT_GET_PRIVATE (r->agent);
+	if (priv->first_secret_time < 0) {
+		priv->first_secret_time = g_get_monotonic_time () - r->keyring_start_time;
+		g_debug ("First keyring search took %" G_GINT64_FORMAT " us", priv->first_secret_time);
+	}
 	connection_id = nm_connection_get_id (r->connection);
 
 	if (g_error_matches (search_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
@@ -285,7 +558,7 @@ keyring_find_secrets_cb (GObject *source,
 		                             NM_SECRET_AGENT_ERROR_USER_CANCELED,
 		                             "The secrets request was canceled by the user");
 		g_error_free (search_error);
-		goto done;
+		goto error;
 	} else if (   (r->flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_ALLOW_INTERACTION)
 	           && g_error_matches (search_error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN)) {
 		/* If the connection always asks for secrets, tolerate
@@ -297,7 +570,7 @@ keyring_find_secrets_cb (GObject *source,
 		                     "%s.%d - failed to read secrets from keyring (%s)",
 		                     __FILE__, __LINE__, search_error->message);
 		g_error_free (search_error);
-		goto done;
+		goto error;
 	}
 
 	/* Only ask if we're allowed to, so that eg a connection editor which
@@ -306,8 +579,12 @@ keyring_find_secrets_cb (GObject *source,
 	 */
 	if (   (r->flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_ALLOW_INTERACTION)
 	    && g_list_length (list) == 0) {
+		gs_unref_variant GVariant *no_secrets = NULL;
+
 		g_message ("No keyring secrets found for %s/%s; asking user.", connection_id, r->setting_name);
-		ask_for_secrets (r);
+		g_list_free_full (list, g_object_unref);
+		no_secrets = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0));
+		ask_for_secrets (r, no_secrets);
 		return;
 	}
 
@@ -369,6 +646,7 @@ keyring_find_secrets_cb (GObject *source,
 			secret_value_unref (secret);
 		}
 	}
+	g_list_free_full (list, g_object_unref);
 
 	if (wg_peers_builder) {
 		g_variant_builder_add (&builder_setting, "{sv}",
@@ -377,54 +655,41 @@ keyring_find_secrets_cb (GObject *source,
 		g_variant_builder_unref (wg_peers_builder);
 	}
 
-	/* If there were hints, and none of the hints were returned by the keyring,
-	 * get some new secrets.
-	 */
-	if (r->flags) {
-		if (r->hints && r->hints[0] && !hint_found)
-			ask = TRUE;
-		else if (r->flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_REQUEST_NEW) {
-			g_message ("New secrets for %s/%s requested; ask the user", connection_id, r->setting_name);
-			ask = TRUE;
-		} else if (   (r->flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_ALLOW_INTERACTION)
-			       && is_connection_always_ask (r->connection))
-			ask = TRUE;
+	setting_secrets = g_variant_ref_sink (g_variant_builder_end (&builder_setting));
+
+	/* Without the Secret Service opened, keyring locking isn't watched */
+	if (   r->fingerprint
+	    && priv->secret_service
+	    && g_variant_n_children (setting_secrets) > 0) {
+		applet_secret_cache_insert (priv->secret_cache,
+		                            nm_connection_get_uuid (r->connection),
+		                            r->setting_name,
+		                            r->fingerprint,
+		                            setting_secrets);
 	}
 
-	/* Returned secrets are a{sa{sv}}; this is the outer a{s...} hash that
-	 * will contain all the individual settings hashes.
-	 */
-	g_variant_builder_init (&builder_connection, NM_VARIANT_TYPE_CONNECTION);
-	g_variant_builder_add (&builder_connection, "{sa{sv}}", r->setting_name, &builder_setting);
-	settings = g_variant_ref_sink (g_variant_builder_end (&builder_connection));
+	get_secrets_complete (r, setting_secrets, hint_found);
+	g_variant_unref (setting_secrets);
+	return;
 
-done:
+error:
 	g_list_free_full (list, g_object_unref);
-	if (ask) {
-		GVariantIter dict_iter;
-		const char *setting_name;
-		GVariant *setting_dict;
-
-		/* Stuff all the found secrets into the connection for the UI to use */
-		g_variant_iter_init (&dict_iter, settings);
-		while (g_variant_iter_next (&dict_iter, "{s@a{sv}}", &setting_name, &setting_dict)) {
-			nm_connection_update_secrets (r->connection,
-			                              setting_name,
-			                              setting_dict,
-			                              NULL);
-			g_variant_unref (setting_dict);
-		}
+	request_complete_get (r, NULL, error);
+	request_free (r);
+	g_error_free (error);
+}
 
-		ask_for_secrets (r);
-	} else {
-		/* Otherwise send the secrets back to NetworkManager */
-		r->get_callback (NM_SECRET_AGENT_OLD (r->agent), r->connection, error ? NULL : settings, error, r->callback_data);
-		request_free (r);
-	}
+/* Identifies the non-secret part of the connection, so that cached secrets
+ * are not handed out for a connection that changed in the meantime. */
+static char *
+connection_fingerprint (NMConnection *connection)
+{
+	gs_unref_variant GVariant *dict = NULL;
 
-	if (settings)
-		g_variant_unref (settings);
-	g_clear_error (&error);
+	dict = nm_connection_to_dbus (connection, NM_CONNECTION_SERIALIZE_NO_SECRETS);
+	return g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+	                                    g_variant_get_data (dict),
+	                                    g_variant_get_size (dict));
 }
 
 static void
@@ -472,24 +737,63 @@ get_secrets (NMSecretAgentOld *agent,
 		return;
 	}
 
+	/* Only handle non-VPN secrets if we're supposed to */
+	if (strcmp (ctype, NM_SETTING_VPN_SETTING_NAME) && priv->vpn_only == TRUE) {
+		error = g_error_new_literal (NM_SECRET_AGENT_ERROR,
+		                             NM_SECRET_AGENT_ERROR_NO_SECRETS,
+		                             "Only handling VPN secrets at this time.");
+		callback (agent, connection, NULL, error, callback_data);
+		g_error_free (error);
+		return;
+	}
+
+	/* NetworkManager may ask again for the same secrets before the first
+	 * request finished, eg for several devices using the same connection;
+	 * don't search the keyring and ask the user twice.
+	 */
+	r = request_find_identical (priv, connection_path, setting_name, hints, flags);
+	if (r) {
+		Waiter *w;
+
+		w = g_slice_new (Waiter);
+		w->connection = g_object_ref (connection);
+		w->callback = callback;
+		w->callback_data = callback_data;
+		r->waiters = g_slist_prepend (r->waiters, w);
+		priv->requests_coalesced++;
+		applet_trace_instant ("agent", "get-secrets-coalesced");
+		return;
+	}
+
 	/* Track the secrets request */
 	r = request_new (agent, connection, connection_path, setting_name, hints, flags, callback, NULL, NULL, callback_data);
 	g_hash_table_insert (priv->requests, GUINT_TO_POINTER (r->id), r);
+	request_index_add (priv, r);
 
 	/* VPN passwords are handled by the VPN plugin's auth dialog */
 	if (!strcmp (ctype, NM_SETTING_VPN_SETTING_NAME)) {
-		ask_for_secrets (r);
+		ask_for_secrets (r, NULL);
 		return;
 	}
 
-	/* Only handle non-VPN secrets if we're supposed to */
-	if (priv->vpn_only == TRUE) {
-		error = g_error_new_literal (NM_SECRET_AGENT_ERROR,
-		                             NM_SECRET_AGENT_ERROR_NO_SECRETS,
-		                             "Only handling VPN secrets at this time.");
-		callback (agent, connection, NULL, error, callback_data);
-		g_error_free (error);
-		return;
+	/* Requests that want something specific, or new secrets because the
+	 * previous ones didn't work, always go to the keyring.
+	 */
+	if (   (flags & NM_SECRET_AGENT_GET_SECRETS_FLAG_REQUEST_NEW)
+	    || (hints && hints[0]))
+		applet_secret_cache_invalidate (priv->secret_cache, uuid);
+	else if (applet_secret_cache_is_enabled (priv->secret_cache)) {
+		GVariant *cached;
+
+		r->fingerprint = connection_fingerprint (connection);
+		cached = applet_secret_cache_lookup (priv->secret_cache, uuid, setting_name, r->fingerprint);
+		if (cached) {
+			g_variant_ref_sink (cached);
+			applet_trace_instant ("agent", "secret-cache-hit");
+			get_secrets_complete (r, cached, FALSE);
+			g_variant_unref (cached);
+			return;
+		}
 	}
 
 	/* For everything else we scrape the keyring for secrets first, and ask
@@ -500,7 +804,8 @@ get_secrets (NMSecretAgentOld *agent,
 	                                 KEYRING_SN_TAG, setting_name,
 	                                 NULL);
 
-	secret_service_search (NULL, &network_manager_secret_schema, attrs,
+	r->keyring_start_time = g_get_monotonic_time ();
+	secret_service_search (priv->secret_service, &network_manager_secret_schema, attrs,
 	                       SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
 	                       r->cancellable, keyring_find_secrets_cb, r);
 
@@ -516,32 +821,35 @@ cancel_get_secrets (NMSecretAgentOld *agent,
                     const char *setting_name)
 {
 	AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (agent);
-	GHashTableIter iter;
+	gs_free char *key = request_index_key (connection_path, setting_name);
+	gpointer orig_key;
+	GPtrArray *array;
 	Request *r;
 	GError *error;
+	guint i;
+
+	/* Take the matching GetSecrets calls out of the tables */
+	if (!g_hash_table_lookup_extended (priv->get_requests, key, &orig_key, (gpointer *) &array))
+		return;
+	g_hash_table_steal (priv->get_requests, key);
+	g_free (orig_key);
 
 	error = g_error_new_literal (NM_SECRET_AGENT_ERROR,
 	                             NM_SECRET_AGENT_ERROR_AGENT_CANCELED,
 	                             "Canceled by NetworkManager");
 
-	g_hash_table_iter_init (&iter, priv->requests);
-	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &r)) {
-		/* Only care about GetSecrets requests here */
-		if (r->get_callback == NULL)
-			continue;
+	for (i = 0; i < array->len; i++) {
+		r = array->pdata[i];
 
-		/* Cancel any matching GetSecrets call */
-		if (   g_strcmp0 (r->path, connection_path) == 0
-		    && g_strcmp0 (r->setting_name, setting_name) == 0) {
-			/* cancel outstanding keyring operations */
-			g_cancellable_cancel (r->cancellable);
+		/* cancel outstanding keyring operations */
+		g_cancellable_cancel (r->cancellable);
 
-			r->get_callback (NM_SECRET_AGENT_OLD (r->agent), r->connection, NULL, error, r->callback_data);
-			g_hash_table_iter_remove (&iter);
-			g_signal_emit (r->agent, signals[CANCEL_SECRETS], 0, GUINT_TO_POINTER (r->id));
-		}
+		request_complete_get (r, NULL, error);
+		g_hash_table_remove (priv->requests, GUINT_TO_POINTER (r->id));
+		g_signal_emit (r->agent, signals[CANCEL_SECRETS], 0, GUINT_TO_POINTER (r->id));
 	}
 
+	g_ptr_array_unref (array);
 	g_error_free (error);
 }
 
@@ -550,26 +858,72 @@ cancel_get_secrets (NMSecretAgentOld *agent,
 static void
 save_request_try_complete (Request *r)
 {
+	AppletAgentPrivate *priv;
+
 	/* Only call the SaveSecrets callback and free the request when all the
 	 * secrets have been saved to the keyring.
 	 */
-	if (r->keyring_calls == 0) {
-		if (!g_cancellable_is_cancelled (r->cancellable))
+	if (r->keyring_calls == 0 && g_queue_is_empty (r->save_queue)) {
+		if (!g_cancellable_is_cancelled (r->cancellable)) {
+			priv = APPLET_AGENT_GET_PRIVATE (r->agent);
+			applet_histogram_add (&priv->save_time, g_get_monotonic_time () - r->save_start_time);
 			r->save_callback (NM_SECRET_AGENT_OLD (r->agent), r->connection, NULL, r->callback_data);
+		}
 		request_free (r);
 	}
 }
 
+static void
+save_request_drop_queue (Request *r)
+{
+	while (!g_queue_is_empty (r->save_queue))
+		save_item_free (g_queue_pop_head (r->save_queue));
+}
+
+static void save_request_write (Request *r);
+
 static void
 save_secret_cb (GObject *source,
                 GAsyncResult *result,
                 gpointer user_data)
 {
+	SaveItem *item = user_data;
+	Request *r = item->r;
+
 	secret_password_store_finish (result, NULL);
-	save_request_try_complete (user_data);
+	request_keyring_call_done_since (r, item->start_time);
+	save_item_free (item);
+	save_request_write (r);
 }
 
+/* Keeps up to save_concurrency keyring writes in flight, and completes the
+ * request once all of them are done.
+ */
+static void
+save_request_write (Request *r)
+{
+	guint concurrency;
+	SaveItem *item;
+
+	if (g_cancellable_is_cancelled (r->cancellable)) {
+		/* Don't start writing anything else */
+		save_request_drop_queue (r);
+		save_request_try_complete (r);
+		return;
+	}
+
+	concurrency = APPLET_AGENT_GET_PRIVATE (r->agent)->save_concurrency;
+	while (   (guint) r->keyring_calls < concurrency
+	       && (item = g_queue_pop_head (r->save_queue))) {
+		item->start_time = g_get_monotonic_time ();
+		secret_password_storev (&network_manager_secret_schema, item->attrs, NULL,
+		                        item->display_name, item->secret,
+		                        r->cancellable, save_secret_cb, item);
+		r->keyring_calls++;
+	}
 
+	save_request_try_complete (r);
+}
 
 static GHashTable *
 _create_keyring_add_attr_list (NMConnection *connection,
@@ -609,8 +963,7 @@ save_one_secret (Request *r,
                  const char *secret,
                  const char *display_name)
 {
-	GHashTable *attrs;
-	char *alt_display_name = NULL;
+	SaveItem *item;
 	const char *setting_name;
 	NMSettingSecretFlags secret_flags = NM_SETTING_SECRET_FLAG_NONE;
 
@@ -623,19 +976,18 @@ save_one_secret (Request *r,
 	setting_name = nm_setting_get_name (setting);
 	g_assert (setting_name);
 
-	attrs = _create_keyring_add_attr_list (r->connection,
-	                                       setting_name,
-	                                       key,
-	                                       display_name ? NULL : &alt_display_name);
-	g_assert (attrs);
-
-	secret_password_storev (&network_manager_secret_schema, attrs, NULL,
-	                        display_name ? display_name : alt_display_name, secret,
-	                        r->cancellable, save_secret_cb, r);
-	r->keyring_calls++;
-
-	g_hash_table_unref (attrs);
-	g_free (alt_display_name);
+	item = g_slice_new0 (SaveItem);
+	item->r = r;
+	item->attrs = _create_keyring_add_attr_list (r->connection,
+	                                             setting_name,
+	                                             key,
+	                                             display_name ? NULL : &item->display_name);
+	g_assert (item->attrs);
+	if (display_name)
+		item->display_name = g_strdup (display_name);
+	item->secret = g_strdup (secret);
+
+	g_queue_push_tail (r->save_queue, item);
 }
 
 static void
@@ -720,16 +1072,114 @@ save_delete_cb (NMSecretAgentOld *agent,
                 GError *error,
                 gpointer user_data)
 {
-	Request *r = user_data;
-
 	/* Ignore errors; now save all new secrets */
-	nm_connection_for_each_setting_value (connection, write_one_secret_to_keyring, r);
+	save_request_write (user_data);
+}
 
-	/* If no secrets actually got saved there may be nothing to do so
-	 * try to complete the request here.  If there were secrets to save the
-	 * request will get completed when those keyring calls return.
-	 */
-	save_request_try_complete (r);
+static void
+add_cached_secrets (GHashTable *table, const char *setting_name, GVariant *dict)
+{
+	GVariantIter iter, peers_iter;
+	const char *key, *public_key, *psk;
+	GVariant *value, *peer;
+
+	g_variant_iter_init (&iter, dict);
+	while (g_variant_iter_next (&iter, "{&sv}", &key, &value)) {
+		if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING)) {
+			g_hash_table_insert (table,
+			                     g_strdup_printf ("%s/%s", setting_name, key),
+			                     g_variant_dup_string (value, NULL));
+		} else if (   nm_streq (key, NM_SETTING_WIREGUARD_PEERS)
+		           && g_variant_is_of_type (value, G_VARIANT_TYPE ("aa{sv}"))) {
+			/* See keyring_find_secrets_cb() */
+			g_variant_iter_init (&peers_iter, value);
+			while ((peer = g_variant_iter_next_value (&peers_iter))) {
+				if (   g_variant_lookup (peer, NM_WIREGUARD_PEER_ATTR_PUBLIC_KEY, "&s", &public_key)
+				    && g_variant_lookup (peer, NM_WIREGUARD_PEER_ATTR_PRESHARED_KEY, "&s", &psk)) {
+					g_hash_table_insert (table,
+					                     g_strdup_printf ("%s/" NM_SETTING_WIREGUARD_PEERS ".%s." NM_WIREGUARD_PEER_ATTR_PRESHARED_KEY,
+					                                      setting_name, public_key),
+					                     g_strdup (psk));
+				}
+				g_variant_unref (peer);
+			}
+		}
+		g_variant_unref (value);
+	}
+}
+
+static void
+collect_secret_settings (NMSetting *setting,
+                         const char *key,
+                         const GValue *value,
+                         GParamFlags flags,
+                         gpointer user_data)
+{
+	GHashTable *setting_names = user_data;
+
+	if (flags & NM_SETTING_PARAM_SECRET)
+		g_hash_table_add (setting_names, (gpointer) nm_setting_get_name (setting));
+}
+
+/* Whether the keyring, as far as the secret cache knows, already holds
+ * exactly the secrets that are about to be saved.  The cache only knows
+ * about settings whose keyring items were read, so any other setting
+ * that can hold secrets might still have items that need deleting.
+ */
+static gboolean
+save_request_is_unchanged (Request *r)
+{
+	AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (r->agent);
+	gs_unref_hashtable GHashTable *cached = NULL;
+	gs_unref_hashtable GHashTable *secret_settings = NULL;
+	gs_unref_variant GVariant *settings = NULL;
+	gs_free char *fingerprint = NULL;
+	GVariantIter iter;
+	const char *setting_name;
+	GVariant *dict;
+	GList *l;
+
+	if (   g_queue_is_empty (r->save_queue)
+	    || !applet_secret_cache_is_enabled (priv->secret_cache))
+		return FALSE;
+
+	fingerprint = connection_fingerprint (r->connection);
+	settings = applet_secret_cache_lookup_connection (priv->secret_cache,
+	                                                  nm_connection_get_uuid (r->connection),
+	                                                  fingerprint);
+	if (!settings)
+		return FALSE;
+	g_variant_ref_sink (settings);
+
+	secret_settings = g_hash_table_new (g_str_hash, g_str_equal);
+	nm_connection_for_each_setting_value (r->connection, collect_secret_settings, secret_settings);
+
+	cached = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) nm_free_secret);
+	g_variant_iter_init (&iter, settings);
+	while (g_variant_iter_next (&iter, "{&s@a{sv}}", &setting_name, &dict)) {
+		add_cached_secrets (cached, setting_name, dict);
+		g_hash_table_remove (secret_settings, setting_name);
+		g_variant_unref (dict);
+	}
+
+	if (g_hash_table_size (secret_settings) > 0)
+		return FALSE;
+
+	if (g_hash_table_size (cached) != g_queue_get_length (r->save_queue))
+		return FALSE;
+
+	for (l = r->save_queue->head; l; l = l->next) {
+		SaveItem *item = l->data;
+		gs_free char *key = NULL;
+
+		key = g_strdup_printf ("%s/%s",
+		                       (char *) g_hash_table_lookup (item->attrs, KEYRING_SN_TAG),
+		                       (char *) g_hash_table_lookup (item->attrs, KEYRING_SK_TAG));
+		if (g_strcmp0 (g_hash_table_lookup (cached, key), item->secret))
+			return FALSE;
+	}
+
+	return TRUE;
 }
 
 static void
@@ -744,6 +1194,22 @@ save_secrets (NMSecretAgentOld *agent,
 
 	r = request_new (agent, connection, connection_path, NULL, NULL, FALSE, NULL, callback, NULL, callback_data);
 	g_hash_table_insert (priv->requests, GUINT_TO_POINTER (r->id), r);
+	r->save_queue = g_queue_new ();
+	r->save_start_time = g_get_monotonic_time ();
+
+	nm_connection_for_each_setting_value (connection, write_one_secret_to_keyring, r);
+
+	/* NetworkManager saves the secrets again after each successful
+	 * activation, mostly the ones just read from the keyring.
+	 */
+	if (save_request_is_unchanged (r)) {
+		priv->saves_skipped++;
+		save_request_drop_queue (r);
+		save_request_try_complete (r);
+		return;
+	}
+
+	applet_secret_cache_invalidate (priv->secret_cache, nm_connection_get_uuid (connection));
 
 	/* First delete any existing items in the keyring */
 	nm_secret_agent_old_delete_secrets (agent, connection, save_delete_cb, r);
@@ -760,7 +1226,7 @@ delete_find_items_cb (GObject *source,
 	GError *secret_error = NULL;
 	GError *error = NULL;
 
-	r->keyring_calls--;
+	request_keyring_call_done (r);
 	if (g_cancellable_is_cancelled (r->cancellable)) {
 		/* Callback already called by NM or dispose */
 		request_free (r);
@@ -800,6 +1266,9 @@ delete_secrets (NMSecretAgentOld *agent,
 	uuid = nm_setting_connection_get_uuid (s_con);
 	g_assert (uuid);
 
+	applet_secret_cache_invalidate (priv->secret_cache, uuid);
+
+	r->keyring_start_time = g_get_monotonic_time ();
 	secret_password_clear (&network_manager_secret_schema, r->cancellable,
 	                       delete_find_items_cb, r,
 	                       KEYRING_UUID_TAG, uuid,
@@ -816,8 +1285,226 @@ applet_agent_handle_vpn_only (AppletAgent *agent, gboolean vpn_only)
 	APPLET_AGENT_GET_PRIVATE (agent)->vpn_only = vpn_only;
 }
 
+void
+applet_agent_add_statistics (AppletAgent *agent, GVariantBuilder *builder)
+{
+	AppletAgentPrivate *priv;
+	GVariantBuilder types, stages;
+	GHashTableIter iter;
+	const char *connection_type;
+	AppletHistogram *histograms;
+	guint i;
+
+	g_return_if_fail (APPLET_IS_AGENT (agent));
+
+	priv = APPLET_AGENT_GET_PRIVATE (agent);
+	g_variant_builder_add (builder, "{sv}", "keyring-calls",
+	                       applet_histogram_to_variant (&priv->keyring_time));
+	g_variant_builder_add (builder, "{sv}", "secret-service-open-us",
+	                       g_variant_new_int64 (priv->secret_service_open_time));
+	g_variant_builder_add (builder, "{sv}", "first-secret-us",
+	                       g_variant_new_int64 (priv->first_secret_time));
+	g_variant_builder_add (builder, "{sv}", "keyring-saves",
+	                       applet_histogram_to_variant (&priv->save_time));
+	g_variant_builder_add (builder, "{sv}", "keyring-saves-skipped",
+	                       g_variant_new_uint64 (priv->saves_skipped));
+	g_variant_builder_add (builder, "{sv}", "get-secrets-coalesced",
+	                       g_variant_new_uint64 (priv->requests_coalesced));
+	g_variant_builder_add (builder, "{sv}", "secret-cache",
+	                       applet_secret_cache_get_statistics (priv->secret_cache));
+
+	g_variant_builder_init (&types, G_VARIANT_TYPE ("a{sa{sv}}"));
+	g_hash_table_iter_init (&iter, priv->stage_times);
+	while (g_hash_table_iter_next (&iter, (gpointer) &connection_type, (gpointer) &histograms)) {
+		g_variant_builder_init (&stages, G_VARIANT_TYPE_VARDICT);
+		for (i = 0; i <= APPLET_AGENT_STAGE_LAST; i++) {
+			g_variant_builder_add (&stages, "{sv}", stage_names[i],
+			                       applet_histogram_to_variant (&histograms[i]));
+		}
+		g_variant_builder_add (&types, "{sa{sv}}", connection_type, &stages);
+	}
+	g_variant_builder_add (builder, "{sv}", "secrets-stages", g_variant_builder_end (&types));
+}
+
+void
+applet_agent_reset_statistics (AppletAgent *agent)
+{
+	AppletAgentPrivate *priv;
+
+	g_return_if_fail (APPLET_IS_AGENT (agent));
+
+	priv = APPLET_AGENT_GET_PRIVATE (agent);
+	applet_histogram_reset (&priv->keyring_time);
+	applet_histogram_reset (&priv->save_time);
+	priv->saves_skipped = 0;
+	priv->requests_coalesced = 0;
+	g_hash_table_remove_all (priv->stage_times);
+	applet_secret_cache_reset_statistics (priv->secret_cache);
+}
+
+/**
+ * applet_agent_add_stage_time:
+ * @agent: the agent
+ * @connection: the connection the secrets were requested for
+ * @stage: which part of answering the request took from @start_time to
+ *   @end_time
+ * @start_time: monotonic time in microseconds
+ * @end_time: monotonic time in microseconds
+ *
+ * Accounts the time to the histograms of the connection's type, and traces it.
+ */
+void
+applet_agent_add_stage_time (AppletAgent *agent,
+                             NMConnection *connection,
+                             AppletAgentStage stage,
+                             gint64 start_time,
+                             gint64 end_time)
+{
+	AppletAgentPrivate *priv;
+	const char *connection_type;
+	AppletHistogram *histograms;
+
+	g_return_if_fail (APPLET_IS_AGENT (agent));
+	g_return_if_fail (stage <= APPLET_AGENT_STAGE_LAST);
+
+	priv = APPLET_AGENT_GET_PRIVATE (agent);
+	if (priv->disposed)
+		return;
+
+	connection_type = nm_connection_get_connection_type (connection);
+	if (!connection_type)
+		connection_type = "unknown";
+
+	histograms = g_hash_table_lookup (priv->stage_times, connection_type);
+	if (!histograms) {
+		histograms = g_new0 (AppletHistogram, APPLET_AGENT_STAGE_LAST + 1);
+		g_hash_table_insert (priv->stage_times, g_strdup (connection_type), histograms);
+	}
+	applet_histogram_add (&histograms[stage], end_time - start_time);
+
+	applet_trace_complete ("agent", stage_names[stage], start_time, end_time);
+}
+
+/**
+ * applet_agent_set_secret_cache_timeout:
+ * @agent: the agent
+ * @timeout_sec: how long to keep secrets read from the keyring in memory;
+ *   0 disables caching them
+ */
+void
+applet_agent_set_secret_cache_timeout (AppletAgent *agent, guint timeout_sec)
+{
+	g_return_if_fail (APPLET_IS_AGENT (agent));
+
+	applet_secret_cache_set_timeout (APPLET_AGENT_GET_PRIVATE (agent)->secret_cache, timeout_sec);
+}
+
+/**
+ * applet_agent_set_save_concurrency:
+ * @agent: the agent
+ * @concurrency: how many secrets of a connection may be written to the
+ *   keyring at the same time
+ */
+void
+applet_agent_set_save_concurrency (AppletAgent *agent, guint concurrency)
+{
+	g_return_if_fail (APPLET_IS_AGENT (agent));
+
+	APPLET_AGENT_GET_PRIVATE (agent)->save_concurrency = MAX (concurrency, 1);
+}
+
 /*******************************************************/
 
+static void
+collection_locked_cb (SecretCollection *collection,
+                      GParamSpec *pspec,
+                      AppletAgent *agent)
+{
+	AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (agent);
+
+	/* Cache hits don't go through the keyring, and so wouldn't notice */
+	if (secret_collection_get_locked (collection)) {
+		g_debug ("Keyring '%s' locked; dropping cached secrets",
+		         g_dbus_proxy_get_object_path (G_DBUS_PROXY (collection)));
+		applet_secret_cache_clear (priv->secret_cache);
+	}
+}
+
+static void
+unwatch_collection (gpointer data)
+{
+	SecretCollection *collection = data;
+
+	g_signal_handlers_disconnect_matched (collection, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+	                                      collection_locked_cb, NULL);
+	g_object_unref (collection);
+}
+
+static void
+watch_collections (SecretService *service, GParamSpec *pspec, AppletAgent *agent)
+{
+	AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (agent);
+	GList *collections, *l;
+
+	g_ptr_array_set_size (priv->watched_collections, 0);
+
+	collections = secret_service_get_collections (service);
+	for (l = collections; l; l = l->next) {
+		g_signal_connect (l->data, "notify::locked",
+		                  G_CALLBACK (collection_locked_cb), agent);
+		g_ptr_array_add (priv->watched_collections, l->data);
+	}
+	g_list_free (collections);
+
+	/* A collection that went away may have been locked with it */
+	if (pspec)
+		applet_secret_cache_clear (priv->secret_cache);
+}
+
+static void
+secret_service_ready_cb (GObject *source,
+                         GAsyncResult *result,
+                         gpointer user_data)
+{
+	AppletAgentPrivate *priv;
+	SecretService *service;
+	gs_free_error GError *error = NULL;
+
+	service = secret_service_get_finish (result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		return;
+
+	priv = APPLET_AGENT_GET_PRIVATE (user_data);
+	if (!service) {
+		/* Lookups will try again by themselves */
+		g_debug ("Could not open the Secret Service: %s", error->message);
+		return;
+	}
+
+	priv->secret_service = service;
+	priv->secret_service_open_time = g_get_monotonic_time () - priv->start_time;
+	watch_collections (service, NULL, user_data);
+	g_signal_connect (service, "notify::collections",
+	                  G_CALLBACK (watch_collections), user_data);
+	applet_trace_complete ("agent", "secret-service-open", priv->start_time, g_get_monotonic_time ());
+}
+
+/* Have the Secret Service started and the collections loaded before the
+ * first secrets request, which NetworkManager only waits for so long.
+ */
+static void
+open_secret_service (AppletAgent *agent)
+{
+	AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (agent);
+
+	priv->start_time = g_get_monotonic_time ();
+	priv->secret_service_cancellable = g_cancellable_new ();
+	secret_service_get (SECRET_SERVICE_OPEN_SESSION | SECRET_SERVICE_LOAD_COLLECTIONS,
+	                    priv->secret_service_cancellable,
+	                    secret_service_ready_cb,
+	                    agent);
+}
+
 AppletAgent *
 applet_agent_new (GError **error)
 {
@@ -832,6 +1519,8 @@ applet_agent_new (GError **error)
 		return NULL;
 	}
 
+	open_secret_service (agent);
+
 	return agent;
 }
 
@@ -841,6 +1530,14 @@ applet_agent_init (AppletAgent *self)
 	AppletAgentPrivate *priv = APPLET_AGENT_GET_PRIVATE (self);
 
 	priv->requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+	priv->get_requests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                            (GDestroyNotify) g_ptr_array_unref);
+	priv->secret_cache = applet_secret_cache_new ();
+	priv->watched_collections = g_ptr_array_new_with_free_func (unwatch_collection);
+	priv->stage_times = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	priv->save_concurrency = 1;
+	priv->secret_service_open_time = -1;
+	priv->first_secret_time = -1;
 }
 
 static void
@@ -859,6 +1556,16 @@ dispose (GObject *object)
 			g_cancellable_cancel (r->cancellable);
 
 		g_hash_table_destroy (priv->requests);
+		g_hash_table_destroy (priv->get_requests);
+		g_hash_table_destroy (priv->stage_times);
+		if (priv->secret_service_cancellable)
+			g_cancellable_cancel (priv->secret_service_cancellable);
+		g_clear_object (&priv->secret_service_cancellable);
+		g_clear_pointer (&priv->watched_collections, g_ptr_array_unref);
+		if (priv->secret_service)
+			g_signal_handlers_disconnect_by_data (priv->secret_service, self);
+		g_clear_object (&priv->secret_service);
+		g_clear_pointer (&priv->secret_cache, applet_secret_cache_free);
 		priv->disposed = TRUE;
 	}
 
@@ -887,8 +1594,8 @@ applet_agent_class_init (AppletAgentClass *agent_class)
 		              G_SIGNAL_RUN_FIRST,
 		              G_STRUCT_OFFSET (AppletAgentClass, get_secrets),
 		              NULL, NULL, NULL,
-		              G_TYPE_NONE, 7,
-		              G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_UINT, G_TYPE_POINTER, G_TYPE_POINTER);
+		              G_TYPE_NONE, 8,
+		              G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_UINT, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER);
 
 	signals[CANCEL_SECRETS] =
 		g_signal_new (APPLET_AGENT_CANCEL_SECRETS,
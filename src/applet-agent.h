@@ -11,6 +11,8 @@
 #include <NetworkManager.h>
 #include <nm-secret-agent-old.h>
 
+#include "applet-stats.h"
+
 #define APPLET_TYPE_AGENT            (applet_agent_get_type ())
 #define APPLET_AGENT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), APPLET_TYPE_AGENT, AppletAgent))
 #define APPLET_AGENT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), APPLET_TYPE_AGENT, AppletAgentClass))
@@ -25,6 +27,16 @@ typedef struct {
 	NMSecretAgentOld parent;
 } AppletAgent;
 
+/* Where the time to answer a secrets request goes */
+typedef enum {
+	APPLET_AGENT_STAGE_KEYRING,      /* searching the keyring */
+	APPLET_AGENT_STAGE_DIALOG_WAIT,  /* from asking the applet to showing a dialog */
+	APPLET_AGENT_STAGE_USER,         /* from showing a dialog to the user's response */
+	APPLET_AGENT_STAGE_AUTH_DIALOG,  /* from spawning a VPN auth dialog to its EOF */
+	APPLET_AGENT_STAGE_REPLY,        /* from the request to the reply to NetworkManager */
+	APPLET_AGENT_STAGE_LAST = APPLET_AGENT_STAGE_REPLY,
+} AppletAgentStage;
+
 typedef void (*AppletAgentSecretsCallback) (AppletAgent *self,
                                             GVariant *secrets,
                                             GError *error,
@@ -39,6 +51,7 @@ typedef struct {
 	                            const char *setting_name,
 	                            const char **hints,
 	                            guint32 flags,
+	                            GVariant *existing_secrets,
 	                            AppletAgentSecretsCallback callback,
 	                            gpointer callback_data);
 
@@ -53,5 +66,19 @@ AppletAgent *applet_agent_new (GError **error);
 
 void applet_agent_handle_vpn_only (AppletAgent *agent, gboolean vpn_only);
 
+void applet_agent_add_statistics (AppletAgent *agent, GVariantBuilder *builder);
+
+void applet_agent_reset_statistics (AppletAgent *agent);
+
+void applet_agent_set_secret_cache_timeout (AppletAgent *agent, guint timeout_sec);
+
+void applet_agent_set_save_concurrency (AppletAgent *agent, guint concurrency);
+
+void applet_agent_add_stage_time (AppletAgent *agent,
+                                  NMConnection *connection,
+                                  AppletAgentStage stage,
+                                  gint64 start_time,
+                                  gint64 end_time);
+
 #endif /* _APPLET_AGENT_H_ */
 
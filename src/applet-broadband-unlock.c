@@ -0,0 +1,525 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* Unlocks the SIMs of modems with the PINs saved in the keyring.  When many
+ * modems show up at once, they share one keyring search for all saved PINs,
+ * indexed by SIM and by device, and only a few PINs are sent to
+ * ModemManager at a time.
+ */
+
+#include "nm-default.h"
+
+#include "applet-broadband-unlock.h"
+#include "applet-stats.h"
+#include "mobile-helpers.h"
+
+/* PINs sent to ModemManager at the same time */
+#define UNLOCK_MAX_SENDS 4
+
+/* How long the index is kept for modems that show up later */
+#define INDEX_LINGER_SEC 10
+
+typedef struct {
+	MMSim *sim;
+	char *devid;
+	char *simid;
+	AppletBroadbandUnlockFunc func;
+	gpointer user_data;
+	GCancellable *cancellable;
+	SecretValue *pin;
+	gint64 start_time;
+} UnlockRequest;
+
+static struct {
+	/* simid or devid => SecretValue */
+	GHashTable *by_simid;
+	GHashTable *by_devid;
+	gboolean loading;
+	guint linger_id;
+
+	GQueue waiting;    /* for the index */
+	GQueue queued;     /* for a free send */
+	GSList *active;    /* sending */
+	guint sending;
+
+	/* The fallback search for PINs saved without the schema name, done at
+	 * most once for each index */
+	GQueue legacy_waiting;
+	gboolean legacy_searching;
+	gboolean legacy_searched;
+	guint generation;
+
+	struct {
+		guint64 keyring_searches;
+		guint64 unlocked;
+		guint64 failed;
+		guint64 no_pin;
+		AppletHistogram unlock_time;
+	} stats;
+} unlock;
+
+static void
+unlock_request_free (UnlockRequest *req)
+{
+	g_object_unref (req->sim);
+	g_free (req->devid);
+	g_free (req->simid);
+	g_object_unref (req->cancellable);
+	if (req->pin)
+		secret_value_unref (req->pin);
+	g_slice_free (UnlockRequest, req);
+}
+
+static void
+unlock_request_finish (UnlockRequest *req, AppletBroadbandUnlockResult result, GError *error)
+{
+	gint64 elapsed = g_get_monotonic_time () - req->start_time;
+
+	switch (result) {
+	case APPLET_BROADBAND_UNLOCK_DONE:
+		unlock.stats.unlocked++;
+		applet_histogram_add (&unlock.stats.unlock_time, elapsed);
+		break;
+	case APPLET_BROADBAND_UNLOCK_FAILED:
+		unlock.stats.failed++;
+		break;
+	case APPLET_BROADBAND_UNLOCK_NO_PIN:
+		unlock.stats.no_pin++;
+		break;
+	}
+
+	g_debug ("SIM auto-unlock of devid '%s': %s after %" G_GINT64_FORMAT " ms",
+	         req->devid,
+	         result == APPLET_BROADBAND_UNLOCK_DONE ? "unlocked" :
+	         result == APPLET_BROADBAND_UNLOCK_FAILED ? "failed" : "no saved PIN",
+	         elapsed / 1000);
+
+	req->func (result, error, req->user_data);
+	unlock_request_free (req);
+}
+
+/*****************************************************************************/
+
+static GHashTable *
+pin_table_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                              (GDestroyNotify) secret_value_unref);
+}
+
+static void
+index_add (GHashTable *table, const char *key, SecretValue *pin)
+{
+	/* The first match wins, as with the keyring lookups */
+	if (key && !g_hash_table_contains (table, key))
+		g_hash_table_insert (table, g_strdup (key), secret_value_ref (pin));
+}
+
+static void
+index_add_items (GHashTable *by_simid, GHashTable *by_devid, GList *items)
+{
+	GList *iter;
+
+	for (iter = items; iter; iter = iter->next) {
+		SecretItem *item = iter->data;
+		GHashTable *attributes;
+		SecretValue *pin;
+
+		pin = secret_item_get_secret (item);
+		if (!pin)
+			continue;
+
+		attributes = secret_item_get_attributes (item);
+		index_add (by_simid, g_hash_table_lookup (attributes, "simid"), pin);
+		index_add (by_devid, g_hash_table_lookup (attributes, "devid"), pin);
+		g_hash_table_unref (attributes);
+		secret_value_unref (pin);
+	}
+}
+
+/* The PIN is really tied to the SIM, not the modem itself, so a PIN saved
+ * for the SIM is better than one saved for the device. */
+static SecretValue *
+index_lookup (GHashTable *by_simid, GHashTable *by_devid, UnlockRequest *req)
+{
+	SecretValue *pin = NULL;
+
+	if (!by_simid)
+		return NULL;
+
+	if (req->simid)
+		pin = g_hash_table_lookup (by_simid, req->simid);
+	if (!pin)
+		pin = g_hash_table_lookup (by_devid, req->devid);
+	return pin;
+}
+
+static gboolean
+index_linger_cb (gpointer user_data)
+{
+	unlock.linger_id = 0;
+	applet_broadband_unlock_invalidate ();
+	return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+
+static void dispatch (void);
+
+static void
+send_pin_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	UnlockRequest *req = user_data;
+	gs_free_error GError *error = NULL;
+	gboolean success;
+
+	success = mm_sim_send_pin_finish (MM_SIM (source), result, &error);
+	unlock.sending--;
+
+	if (g_cancellable_is_cancelled (req->cancellable))
+		unlock_request_free (req);
+	else {
+		unlock.active = g_slist_remove (unlock.active, req);
+		if (success)
+			unlock_request_finish (req, APPLET_BROADBAND_UNLOCK_DONE, NULL);
+		else
+			unlock_request_finish (req, APPLET_BROADBAND_UNLOCK_FAILED, error);
+	}
+
+	dispatch ();
+}
+
+/* Sends the queued PINs there's room for */
+static void
+dispatch (void)
+{
+	UnlockRequest *req;
+
+	while (   unlock.sending < UNLOCK_MAX_SENDS
+	       && (req = g_queue_pop_head (&unlock.queued))) {
+		unlock.sending++;
+		unlock.active = g_slist_prepend (unlock.active, req);
+		mm_sim_send_pin (req->sim,
+		                 secret_value_get (req->pin, NULL),
+		                 req->cancellable,
+		                 send_pin_cb,
+		                 req);
+	}
+}
+
+static void
+request_send (UnlockRequest *req, SecretValue *pin)
+{
+	req->pin = secret_value_ref (pin);
+	g_queue_push_tail (&unlock.queued, req);
+	dispatch ();
+}
+
+typedef struct {
+	guint generation;
+	GList *items;
+} LegacySearch;
+
+static void
+legacy_search_done (LegacySearch *search)
+{
+	gs_unref_hashtable GHashTable *by_simid = NULL;
+	gs_unref_hashtable GHashTable *by_devid = NULL;
+	UnlockRequest *req;
+	SecretValue *pin;
+
+	unlock.legacy_searching = FALSE;
+
+	if (search->generation == unlock.generation && unlock.by_simid) {
+		by_simid = g_hash_table_ref (unlock.by_simid);
+		by_devid = g_hash_table_ref (unlock.by_devid);
+		unlock.legacy_searched = TRUE;
+	} else {
+		/* The index was dropped in the meantime, and isn't brought back
+		 * without its linger timeout */
+		by_simid = pin_table_new ();
+		by_devid = pin_table_new ();
+	}
+	index_add_items (by_simid, by_devid, search->items);
+	g_list_free_full (search->items, g_object_unref);
+	g_slice_free (LegacySearch, search);
+
+	while ((req = g_queue_pop_head (&unlock.legacy_waiting))) {
+		pin = index_lookup (by_simid, by_devid, req);
+		if (pin)
+			request_send (req, pin);
+		else
+			unlock_request_finish (req, APPLET_BROADBAND_UNLOCK_NO_PIN, NULL);
+	}
+}
+
+static void
+legacy_load_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	gs_free_error GError *error = NULL;
+
+	if (!secret_item_load_secrets_finish (result, &error))
+		g_debug ("Couldn't read the untagged SIM PINs: %s", error->message);
+	legacy_search_done (user_data);
+}
+
+static void
+legacy_unlock_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	LegacySearch *search = user_data;
+	gs_free_error GError *error = NULL;
+
+	if (secret_service_unlock_finish (NULL, result, NULL, &error) < 0)
+		g_debug ("Couldn't unlock the untagged SIM PINs: %s", error->message);
+	secret_item_load_secrets (search->items, NULL, legacy_load_cb, search);
+}
+
+static void
+legacy_search_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	LegacySearch *search = user_data;
+	gs_free_error GError *error = NULL;
+	GList *items, *iter;
+
+	items = secret_service_search_finish (NULL, result, &error);
+	if (error)
+		g_debug ("Couldn't search the keyring for untagged SIM PINs: %s", error->message);
+
+	/* Only the items that look like PINs are unlocked and read */
+	for (iter = items; iter; iter = iter->next) {
+		SecretItem *item = iter->data;
+		GHashTable *attributes = secret_item_get_attributes (item);
+
+		if (   (   g_hash_table_contains (attributes, "devid")
+		        || g_hash_table_contains (attributes, "simid"))
+		    && !nm_streq0 (g_hash_table_lookup (attributes, "xdg:schema"), mobile_secret_schema.name))
+			search->items = g_list_prepend (search->items, g_object_ref (item));
+		g_hash_table_unref (attributes);
+	}
+	g_list_free_full (items, g_object_unref);
+	search->items = g_list_reverse (search->items);
+
+	if (!search->items) {
+		legacy_search_done (search);
+		return;
+	}
+
+	secret_service_unlock (NULL, search->items, NULL, legacy_unlock_cb, search);
+}
+
+/* PINs saved before the keyring items were tagged with the schema name
+ * aren't found by the index search.  As they can't be searched for by
+ * the presence of an attribute, all items are listed, without their
+ * secrets, and only those with a devid or simid read. */
+static void
+legacy_search (void)
+{
+	gs_unref_hashtable GHashTable *attrs = NULL;
+	LegacySearch *search;
+
+	unlock.legacy_searching = TRUE;
+	unlock.stats.keyring_searches++;
+
+	search = g_slice_new0 (LegacySearch);
+	search->generation = unlock.generation;
+
+	attrs = g_hash_table_new (g_str_hash, g_str_equal);
+	secret_service_search (NULL, NULL, attrs, SECRET_SEARCH_ALL,
+	                       NULL, legacy_search_cb, search);
+}
+
+/* Queues @req for sending its PIN, if one is known */
+static void
+request_lookup (UnlockRequest *req)
+{
+	SecretValue *pin;
+
+	pin = index_lookup (unlock.by_simid, unlock.by_devid, req);
+	if (pin) {
+		request_send (req, pin);
+		return;
+	}
+
+	if (unlock.legacy_searched) {
+		unlock_request_finish (req, APPLET_BROADBAND_UNLOCK_NO_PIN, NULL);
+		return;
+	}
+
+	g_queue_push_tail (&unlock.legacy_waiting, req);
+	if (!unlock.legacy_searching)
+		legacy_search ();
+}
+
+static void
+index_search_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	gs_free_error GError *error = NULL;
+	UnlockRequest *req;
+	GList *items;
+
+	unlock.loading = FALSE;
+
+	items = secret_service_search_finish (NULL, result, &error);
+	if (error)
+		g_debug ("Couldn't search the keyring for SIM PINs: %s", error->message);
+
+	unlock.by_simid = pin_table_new ();
+	unlock.by_devid = pin_table_new ();
+	index_add_items (unlock.by_simid, unlock.by_devid, items);
+	g_list_free_full (items, g_object_unref);
+
+	nm_clear_g_source (&unlock.linger_id);
+	unlock.linger_id = g_timeout_add_seconds (INDEX_LINGER_SEC, index_linger_cb, NULL);
+
+	while ((req = g_queue_pop_head (&unlock.waiting)))
+		request_lookup (req);
+}
+
+static void
+index_load (void)
+{
+	GHashTable *attrs;
+
+	applet_broadband_unlock_invalidate ();
+	unlock.loading = TRUE;
+	unlock.stats.keyring_searches++;
+
+	/* The schema doesn't match by name, for PINs saved by older versions,
+	 * but libsecret still tags the items it stores with it. */
+	attrs = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (attrs, (gpointer) "xdg:schema", (gpointer) mobile_secret_schema.name);
+	secret_service_search (NULL, NULL, attrs,
+	                       SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
+	                       NULL, index_search_cb, NULL);
+	g_hash_table_unref (attrs);
+}
+
+/*****************************************************************************/
+
+/**
+ * applet_broadband_unlock_start:
+ * @sim: the SIM to unlock
+ * @devid: the device identifier of its modem
+ * @func: called with the result, unless cancelled
+ * @user_data: passed to @func, and identifies the unlock for
+ *   applet_broadband_unlock_cancel()
+ *
+ * Unlocks @sim with the PIN saved for it, or else for @devid.
+ */
+void
+applet_broadband_unlock_start (MMSim *sim,
+                               const char *devid,
+                               AppletBroadbandUnlockFunc func,
+                               gpointer user_data)
+{
+	UnlockRequest *req;
+
+	g_return_if_fail (MM_IS_SIM (sim));
+	g_return_if_fail (devid);
+	g_return_if_fail (func);
+
+	req = g_slice_new0 (UnlockRequest);
+	req->sim = g_object_ref (sim);
+	req->devid = g_strdup (devid);
+	req->simid = g_strdup (mm_sim_get_identifier (sim));
+	req->func = func;
+	req->user_data = user_data;
+	req->cancellable = g_cancellable_new ();
+	req->start_time = g_get_monotonic_time ();
+
+	if (unlock.linger_id) {
+		request_lookup (req);
+		return;
+	}
+
+	g_queue_push_tail (&unlock.waiting, req);
+	if (!unlock.loading)
+		index_load ();
+}
+
+static void
+queue_cancel (GQueue *queue, gpointer user_data)
+{
+	GList *iter, *next;
+
+	for (iter = queue->head; iter; iter = next) {
+		UnlockRequest *req = iter->data;
+
+		next = iter->next;
+		if (req->user_data == user_data) {
+			g_queue_delete_link (queue, iter);
+			unlock_request_free (req);
+		}
+	}
+}
+
+/**
+ * applet_broadband_unlock_cancel:
+ * @user_data: as passed to applet_broadband_unlock_start()
+ *
+ * Cancels the unlocks started with @user_data; their callbacks aren't called.
+ */
+void
+applet_broadband_unlock_cancel (gpointer user_data)
+{
+	GSList *iter, *next;
+
+	queue_cancel (&unlock.waiting, user_data);
+	queue_cancel (&unlock.queued, user_data);
+	queue_cancel (&unlock.legacy_waiting, user_data);
+
+	/* These are freed once their send returns */
+	for (iter = unlock.active; iter; iter = next) {
+		UnlockRequest *req = iter->data;
+
+		next = iter->next;
+		if (req->user_data == user_data) {
+			g_cancellable_cancel (req->cancellable);
+			unlock.active = g_slist_delete_link (unlock.active, iter);
+		}
+	}
+}
+
+/**
+ * applet_broadband_unlock_invalidate:
+ *
+ * Forgets the PINs read from the keyring, for when they have been changed.
+ */
+void
+applet_broadband_unlock_invalidate (void)
+{
+	nm_clear_g_source (&unlock.linger_id);
+	g_clear_pointer (&unlock.by_simid, g_hash_table_unref);
+	g_clear_pointer (&unlock.by_devid, g_hash_table_unref);
+	unlock.legacy_searched = FALSE;
+	unlock.generation++;
+}
+
+void
+applet_broadband_unlock_add_statistics (GVariantBuilder *builder)
+{
+	GVariantBuilder stats;
+
+	g_variant_builder_init (&stats, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&stats, "{sv}", "keyring-searches",
+	                       g_variant_new_uint64 (unlock.stats.keyring_searches));
+	g_variant_builder_add (&stats, "{sv}", "unlocked",
+	                       g_variant_new_uint64 (unlock.stats.unlocked));
+	g_variant_builder_add (&stats, "{sv}", "failed",
+	                       g_variant_new_uint64 (unlock.stats.failed));
+	g_variant_builder_add (&stats, "{sv}", "no-pin",
+	                       g_variant_new_uint64 (unlock.stats.no_pin));
+	g_variant_builder_add (&stats, "{sv}", "unlock-time",
+	                       applet_histogram_to_variant (&unlock.stats.unlock_time));
+	g_variant_builder_add (builder, "{sv}", "sim-unlock",
+	                       g_variant_builder_end (&stats));
+}
+
+void
+applet_broadband_unlock_reset_statistics (void)
+{
+	memset (&unlock.stats, 0, sizeof (unlock.stats));
+}
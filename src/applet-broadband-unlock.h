@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_BROADBAND_UNLOCK_H
+#define APPLET_BROADBAND_UNLOCK_H
+
+#include <libmm-glib.h>
+
+typedef enum {
+	APPLET_BROADBAND_UNLOCK_NO_PIN,
+	APPLET_BROADBAND_UNLOCK_FAILED,
+	APPLET_BROADBAND_UNLOCK_DONE,
+} AppletBroadbandUnlockResult;
+
+/* @error is set for APPLET_BROADBAND_UNLOCK_FAILED */
+typedef void (*AppletBroadbandUnlockFunc) (AppletBroadbandUnlockResult result,
+                                           GError *error,
+                                           gpointer user_data);
+
+void applet_broadband_unlock_start (MMSim *sim,
+                                    const char *devid,
+                                    AppletBroadbandUnlockFunc func,
+                                    gpointer user_data);
+
+void applet_broadband_unlock_cancel (gpointer user_data);
+
+void applet_broadband_unlock_invalidate (void);
+
+void applet_broadband_unlock_add_statistics (GVariantBuilder *builder);
+void applet_broadband_unlock_reset_statistics (void);
+
+#endif  /* APPLET_BROADBAND_UNLOCK_H */
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* Exports a small statistics interface next to the GApplication object on
+ * the session bus, so that the applet's behavior can be sampled on machines
+ * where attaching a debugger or profiler is not possible:
+ *
+ *   gdbus call --session --dest org.freedesktop.network-manager-applet \
+ *     --object-path /org/freedesktop/network_manager_applet \
+ *     --method org.freedesktop.network-manager-applet.Debug.GetStatistics
+ */
+
+#include "nm-default.h"
+
+#include "applet-debug.h"
+
+#if WITH_WWAN
+# include "applet-broadband-unlock.h"
+#endif
+
+#define DEBUG_INTERFACE "org.freedesktop.network-manager-applet.Debug"
+
+static const char debug_introspection_xml[] =
+	"<node>"
+	"  <interface name='" DEBUG_INTERFACE "'>"
+	"    <method name='GetStatistics'>"
+	"      <arg type='a{sv}' name='statistics' direction='out'/>"
+	"    </method>"
+	"    <method name='Reset'/>"
+	"  </interface>"
+	"</node>";
+
+static GVariant *
+get_access_points (NMApplet *applet)
+{
+	GVariantBuilder builder;
+	const GPtrArray *devices;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+
+	devices = applet->nm_client ? nm_client_get_devices (applet->nm_client) : NULL;
+	for (i = 0; devices && i < devices->len; i++) {
+		NMDevice *device = devices->pdata[i];
+		const GPtrArray *aps;
+
+		if (!NM_IS_DEVICE_WIFI (device))
+			continue;
+
+		aps = nm_device_wifi_get_access_points (NM_DEVICE_WIFI (device));
+		g_variant_builder_add (&builder, "{su}",
+		                       nm_device_get_iface (device),
+		                       aps ? aps->len : 0);
+	}
+
+	return g_variant_builder_end (&builder);
+}
+
+/* g_type_get_instance_count() only counts while GOBJECT_DEBUG=instance-count
+ * is set in the environment; otherwise all counts are zero. */
+static guint
+count_instances (GType type, GVariantBuilder *builder)
+{
+	gs_free GType *children = NULL;
+	guint n_children, i;
+	guint total = 0;
+	int count = 0;
+
+#if GLIB_CHECK_VERSION (2, 44, 0)
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	count = g_type_get_instance_count (type);
+	G_GNUC_END_IGNORE_DEPRECATIONS
+#endif
+
+	if (count > 0) {
+		g_variant_builder_add (builder, "{su}", g_type_name (type), (guint32) count);
+		total += count;
+	}
+
+	children = g_type_children (type, &n_children);
+	for (i = 0; i < n_children; i++)
+		total += count_instances (children[i], builder);
+
+	return total;
+}
+
+static gint64
+time_since_startup (NMApplet *applet, gint64 timestamp)
+{
+	return timestamp ? timestamp - applet->startup_time : -1;
+}
+
+static GVariant *
+get_statistics (NMApplet *applet)
+{
+	GVariantBuilder builder;
+	GVariantBuilder instances;
+	guint64 lookups;
+	guint objects;
+
+	lookups = applet->stats.icon_cache_hits + applet->stats.icon_cache_misses;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "time-to-client-ready-us",
+	                       g_variant_new_int64 (time_since_startup (applet, applet->client_ready_time)));
+	g_variant_builder_add (&builder, "{sv}", "time-to-initial-state-us",
+	                       g_variant_new_int64 (time_since_startup (applet, applet->initial_state_time)));
+	g_variant_builder_add (&builder, "{sv}", "time-to-first-icon-us",
+	                       g_variant_new_int64 (time_since_startup (applet, applet->first_icon_time)));
+	g_variant_builder_add (&builder, "{sv}", "startup-rss-kb",
+	                       g_variant_new_uint64 (applet->startup_rss_kb));
+	g_variant_builder_add (&builder, "{sv}", "rss-kb",
+	                       g_variant_new_uint64 (applet_get_rss_kb ()));
+	g_variant_builder_add (&builder, "{sv}", "menu-updates",
+	                       applet_histogram_to_variant (&applet->stats.menu_update_time));
+	g_variant_builder_add (&builder, "{sv}", "icon-updates",
+	                       applet_histogram_to_variant (&applet->stats.icon_update_time));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-size",
+	                       g_variant_new_uint32 (applet->icon_cache ? g_hash_table_size (applet->icon_cache) : 0));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-hits",
+	                       g_variant_new_uint64 (applet->stats.icon_cache_hits));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-misses",
+	                       g_variant_new_uint64 (applet->stats.icon_cache_misses));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-hit-rate",
+	                       g_variant_new_double (lookups ? (double) applet->stats.icon_cache_hits / lookups : 0.0));
+	g_variant_builder_add (&builder, "{sv}", "secrets-requests",
+	                       g_variant_new_uint32 (g_hash_table_size (applet->secrets_reqs)));
+	g_variant_builder_add (&builder, "{sv}", "access-points",
+	                       get_access_points (applet));
+
+	g_variant_builder_init (&instances, G_VARIANT_TYPE ("a{su}"));
+	objects = count_instances (G_TYPE_OBJECT, &instances);
+	g_variant_builder_add (&builder, "{sv}", "object-count",
+	                       g_variant_new_uint32 (objects));
+	g_variant_builder_add (&builder, "{sv}", "object-counts",
+	                       g_variant_builder_end (&instances));
+
+	if (applet->agent)
+		applet_agent_add_statistics (applet->agent, &builder);
+#if WITH_WWAN
+	applet_broadband_unlock_add_statistics (&builder);
+#endif
+
+	return g_variant_builder_end (&builder);
+}
+
+void
+applet_debug_reset_statistics (NMApplet *applet)
+{
+	memset (&applet->stats, 0, sizeof (applet->stats));
+	if (applet->agent)
+		applet_agent_reset_statistics (applet->agent);
+#if WITH_WWAN
+	applet_broadband_unlock_reset_statistics ();
+#endif
+}
+
+static void
+debug_method_call (GDBusConnection *connection,
+                   const char *sender,
+                   const char *object_path,
+                   const char *interface_name,
+                   const char *method_name,
+                   GVariant *parameters,
+                   GDBusMethodInvocation *invocation,
+                   gpointer user_data)
+{
+	NMApplet *applet = NM_APPLET (user_data);
+
+	if (!strcmp (method_name, "GetStatistics")) {
+		g_dbus_method_invocation_return_value (invocation,
+		                                       g_variant_new ("(@a{sv})", get_statistics (applet)));
+	} else if (!strcmp (method_name, "Reset")) {
+		applet_debug_reset_statistics (applet);
+		g_dbus_method_invocation_return_value (invocation, NULL);
+	} else {
+		g_dbus_method_invocation_return_error (invocation,
+		                                       G_DBUS_ERROR,
+		                                       G_DBUS_ERROR_UNKNOWN_METHOD,
+		                                       "Unknown method %s", method_name);
+	}
+}
+
+static const GDBusInterfaceVTable debug_vtable = {
+	.method_call = debug_method_call,
+};
+
+gboolean
+applet_debug_register (NMApplet *applet,
+                       GDBusConnection *connection,
+                       const char *object_path,
+                       GError **error)
+{
+	static GDBusNodeInfo *node_info;
+
+	g_return_val_if_fail (!applet->debug_registration_id, FALSE);
+
+	if (!node_info) {
+		node_info = g_dbus_node_info_new_for_xml (debug_introspection_xml, error);
+		if (!node_info)
+			return FALSE;
+	}
+
+	applet->debug_registration_id = g_dbus_connection_register_object (connection,
+	                                                                   object_path,
+	                                                                   node_info->interfaces[0],
+	                                                                   &debug_vtable,
+	                                                                   applet,
+	                                                                   NULL,
+	                                                                   error);
+	return applet->debug_registration_id != 0;
+}
+
+void
+applet_debug_unregister (NMApplet *applet, GDBusConnection *connection)
+{
+	if (applet->debug_registration_id) {
+		g_dbus_connection_unregister_object (connection, applet->debug_registration_id);
+		applet->debug_registration_id = 0;
+	}
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_DEBUG_H
+#define APPLET_DEBUG_H
+
+#include "applet.h"
+
+gboolean applet_debug_register (NMApplet *applet,
+                                GDBusConnection *connection,
+                                const char *object_path,
+                                GError **error);
+
+void     applet_debug_unregister (NMApplet *applet,
+                                  GDBusConnection *connection);
+
+void     applet_debug_reset_statistics (NMApplet *applet);
+
+#endif  /* APPLET_DEBUG_H */
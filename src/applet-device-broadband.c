@@ -12,6 +12,7 @@
 
 #include "applet.h"
 #include "applet-device-broadband.h"
+#include "applet-broadband-unlock.h"
 #include "applet-dialogs.h"
 #include "mobile-helpers.h"
 #include "mb-menu-item.h"
@@ -33,7 +34,15 @@ typedef struct {
 	guint operator_name_update_id;
 	guint operator_code_update_id;
 	guint sid_update_id;
-	NMAMobileProvidersDatabase *mpd;
+
+	/* What the icon and menu show; updated only when that would change */
+	guint32 quality;
+	guint32 act;
+
+	/* Menu items kept across menu rebuilds, for the active connection and
+	 * for the device's registration status, until the menu is destroyed */
+	GtkWidget *active_item;
+	GtkWidget *status_item;
 
 	/* Unlock dialog stuff */
 	GtkWidget *dialog;
@@ -215,6 +224,7 @@ dialog_sim_send_pin_ready (MMSim *sim,
 		                                   code1);
 	} else
 		mobile_helper_delete_pin_in_keyring (mm_modem_get_device_identifier (info->mm_modem));
+	applet_broadband_unlock_invalidate ();
 
 	unlock_dialog_destroy (info);
 }
@@ -319,91 +329,31 @@ unlock_dialog_new (NMDevice *device,
 }
 
 static void
-autounlock_sim_send_pin_ready (MMSim *sim,
-                               GAsyncResult *res,
-                               BroadbandDeviceInfo *info)
+autounlock_done (AppletBroadbandUnlockResult result,
+                 GError *error,
+                 gpointer user_data)
 {
-	GError *error = NULL;
+	BroadbandDeviceInfo *info = user_data;
 
-	if (!mm_sim_send_pin_finish (sim, res, &error)) {
+	switch (result) {
+	case APPLET_BROADBAND_UNLOCK_DONE:
+		return;
+	case APPLET_BROADBAND_UNLOCK_FAILED:
 		g_warning ("Failed to auto-unlock devid: '%s' simid: '%s' : %s",
 		           mm_modem_get_device_identifier (info->mm_modem),
 		           mm_sim_get_identifier (info->mm_sim),
 		           error->message);
-		g_error_free (error);
 
 		/* Remove PIN from keyring right away */
 		mobile_helper_delete_pin_in_keyring (mm_modem_get_device_identifier (info->mm_modem));
-
-		/* Ask the user */
-		unlock_dialog_new (info->device, info);
-	}
-}
-
-static void
-keyring_pin_check_cb (GObject *source,
-                      GAsyncResult *result,
-                      gpointer user_data)
-{
-	BroadbandDeviceInfo *info = user_data;
-	GList *iter;
-	GList *list;
-	SecretItem *item;
-	SecretValue *pin = NULL;
-	GHashTable *attributes;
-	GError *error = NULL;
-	const char *simid;
-
-	list = secret_service_search_finish (NULL, result, &error);
-
-	if (error != NULL) {
-		/* No saved PIN, just ask the user */
-		unlock_dialog_new (info->device, info);
-		g_error_free (error);
-		return;
-	}
-
-	/* Look for a result with a matching "simid" attribute since that's
-	 * better than just using a matching "devid".  The PIN is really tied
-	 * to the SIM, not the modem itself.
-	 */
-	simid = mm_sim_get_identifier (info->mm_sim);
-	if (simid) {
-		for (iter = list;
-		     (pin == NULL) && iter;
-		     iter = g_list_next (iter)) {
-			item = iter->data;
-
-			/* Look for a matching "simid" attribute */
-			attributes = secret_item_get_attributes (item);
-			if (g_strcmp0 (simid, g_hash_table_lookup (attributes, "simid")))
-				pin = secret_item_get_secret (item);
-			else
-				pin = NULL;
-			g_hash_table_unref (attributes);
-
-			if (pin != NULL)
-				break;
-		}
-	}
-
-	if (pin == NULL) {
-		/* Fall back to the first result's PIN if we have one */
-		if (list)
-			pin = secret_item_get_secret (list->data);
-		if (pin == NULL) {
-			unlock_dialog_new (info->device, info);
-			return;
-		}
+		applet_broadband_unlock_invalidate ();
+		break;
+	case APPLET_BROADBAND_UNLOCK_NO_PIN:
+		break;
 	}
 
-	/* Send the PIN code to ModemManager */
-	mm_sim_send_pin (info->mm_sim,
-	                 secret_value_get (pin, NULL),
-	                 NULL, /* cancellable */
-	                 (GAsyncReadyCallback)autounlock_sim_send_pin_ready,
-	                 info);
-	secret_value_unref (pin);
+	/* Ask the user */
+	unlock_dialog_new (info->device, info);
 }
 
 static void
@@ -411,8 +361,6 @@ modem_get_sim_ready (MMModem *modem,
                      GAsyncResult *res,
                      BroadbandDeviceInfo *info)
 {
-	GHashTable *attrs;
-
 	info->mm_sim = mm_modem_get_sim_finish (modem, res, NULL);
 	if (!info->mm_sim)
 		/* Ok, the modem may not need it actually */
@@ -425,13 +373,10 @@ modem_get_sim_ready (MMModem *modem,
 	/* If we have a device ID ask the keyring for any saved SIM-PIN codes */
 	if (mm_modem_get_device_identifier (info->mm_modem) &&
 	    mm_modem_get_unlock_required (info->mm_modem) == MM_MODEM_LOCK_SIM_PIN) {
-		attrs = secret_attributes_build (&mobile_secret_schema, "devid",
-		                                 mm_modem_get_device_identifier (info->mm_modem),
-		                                 NULL);
-		secret_service_search (NULL, &mobile_secret_schema, attrs,
-		                       SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS,
-		                       info->cancellable, keyring_pin_check_cb, info);
-		g_hash_table_unref (attrs);
+		applet_broadband_unlock_start (info->mm_sim,
+		                               mm_modem_get_device_identifier (info->mm_modem),
+		                               autounlock_done,
+		                               info);
 	} else {
 		/* Couldn't get a device ID, but unlock required; present dialog */
 		unlock_dialog_new (info->device, info);
@@ -644,8 +589,8 @@ get_icon (NMDevice *device,
 	                        tip,
 	                        applet,
 	                        broadband_state_to_mb_state (info),
-	                        broadband_act_to_mb_act (info),
-	                        mm_modem_get_signal_quality (info->mm_modem, NULL),
+	                        info->act,
+	                        info->quality,
 	                        (mm_modem_get_state (info->mm_modem) >= MM_MODEM_STATE_ENABLED));
 }
 
@@ -693,6 +638,12 @@ add_connection_item (NMDevice *device,
 	info->device = g_object_ref (device);
 	info->connection = connection ? g_object_ref (connection) : NULL;
 
+	/* A kept item still points to what it was for in the previous menu */
+	g_signal_handlers_disconnect_matched (item, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+	                                      menu_item_activate, NULL);
+	if (gtk_widget_get_parent (item))
+		gtk_container_remove (GTK_CONTAINER (gtk_widget_get_parent (item)), item);
+
 	g_signal_connect_data (item, "activate",
 	                       G_CALLBACK (menu_item_activate),
 	                       info,
@@ -702,6 +653,65 @@ add_connection_item (NMDevice *device,
 	gtk_widget_show (item);
 }
 
+static void
+mb_menu_item_destroyed (GtkWidget *item, BroadbandDeviceInfo *info)
+{
+	if (info->active_item == item)
+		info->active_item = NULL;
+	else if (info->status_item == item)
+		info->status_item = NULL;
+	g_object_unref (item);
+}
+
+static void
+mb_menu_item_update (BroadbandDeviceInfo *info, GtkWidget *item)
+{
+	NMMbMenuItem *mb_item = NM_MB_MENU_ITEM (item);
+
+	nm_mb_menu_item_set_provider (mb_item, info->operator_name);
+	nm_mb_menu_item_set_technology (mb_item, info->act);
+	nm_mb_menu_item_set_state (mb_item,
+	                           broadband_state_to_mb_state (info),
+	                           mm_modem_get_state (info->mm_modem) >= MM_MODEM_STATE_ENABLED);
+	nm_mb_menu_item_set_strength (mb_item, info->quality);
+}
+
+/* Brings the kept menu items up to date, so that a change in the signal or
+ * the operator doesn't take rebuilding the menu. */
+static void
+mb_menu_items_update (BroadbandDeviceInfo *info)
+{
+	if (info->active_item)
+		mb_menu_item_update (info, info->active_item);
+	if (info->status_item)
+		mb_menu_item_update (info, info->status_item);
+}
+
+static GtkWidget *
+mb_menu_item_get (BroadbandDeviceInfo *info,
+                  GtkWidget **item,
+                  const char *connection_name,
+                  gboolean active)
+{
+	if (*item) {
+		nm_mb_menu_item_set_connection (NM_MB_MENU_ITEM (*item), connection_name, active);
+		mb_menu_item_update (info, *item);
+		return *item;
+	}
+
+	*item = nm_mb_menu_item_new (connection_name,
+	                             info->quality,
+	                             info->operator_name,
+	                             active,
+	                             info->act,
+	                             broadband_state_to_mb_state (info),
+	                             mm_modem_get_state (info->mm_modem) >= MM_MODEM_STATE_ENABLED,
+	                             info->applet);
+	g_object_ref_sink (*item);
+	g_signal_connect (*item, "destroy", G_CALLBACK (mb_menu_item_destroyed), info);
+	return *item;
+}
+
 static gboolean
 add_menu_item (NMDevice *device,
                gboolean multiple_devices,
@@ -744,14 +754,7 @@ add_menu_item (NMDevice *device,
 		s_con = nm_connection_get_setting_connection (active);
 		g_assert (s_con);
 
-		item = nm_mb_menu_item_new (nm_setting_connection_get_id (s_con),
-		                            mm_modem_get_signal_quality (info->mm_modem, NULL),
-		                            info->operator_name,
-		                            TRUE,
-		                            broadband_act_to_mb_act (info),
-		                            broadband_state_to_mb_state (info),
-		                            mm_modem_get_state (info->mm_modem) >= MM_MODEM_STATE_ENABLED,
-		                            applet);
+		item = mb_menu_item_get (info, &info->active_item, nm_setting_connection_get_id (s_con), TRUE);
 		gtk_widget_set_sensitive (GTK_WIDGET (item), TRUE);
 		add_connection_item (device, active, item, menu, applet);
 	}
@@ -765,15 +768,10 @@ add_menu_item (NMDevice *device,
 		}
 	} else {
 		/* Otherwise show idle registration state or disabled */
-		item = nm_mb_menu_item_new (NULL,
-		                            mm_modem_get_signal_quality (info->mm_modem, NULL),
-		                            info->operator_name,
-		                            FALSE,
-		                            broadband_act_to_mb_act (info),
-		                            broadband_state_to_mb_state (info),
-		                            mm_modem_get_state (info->mm_modem) >= MM_MODEM_STATE_ENABLED,
-		                            applet);
+		item = mb_menu_item_get (info, &info->status_item, NULL, FALSE);
 		gtk_widget_set_sensitive (GTK_WIDGET (item), FALSE);
+		if (gtk_widget_get_parent (item))
+			gtk_container_remove (GTK_CONTAINER (gtk_widget_get_parent (item)), item);
 		gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
 		gtk_widget_show (item);
 	}
@@ -818,13 +816,27 @@ notify_connected (NMDevice *device,
 
 /********************************************************************/
 
+/* Modems in poor coverage report the quality several times a second, while
+ * only the signal level is shown, so redraw only when that changes. */
 static void
 signal_quality_updated (GObject *object,
                         GParamSpec *pspec,
                         BroadbandDeviceInfo *info)
 {
+	guint32 quality = mm_modem_get_signal_quality (info->mm_modem, NULL);
+	guint level = mobile_helper_get_quality_level (info->quality);
+	guint hysteresis;
+
+	hysteresis = g_settings_get_uint (info->applet->gsettings, PREF_BROADBAND_SIGNAL_HYSTERESIS);
+
+	/* No signal at all isn't worth waiting for: the menu shows no level then */
+	if (   mobile_helper_update_quality_level (level, quality, hysteresis) == level
+	    && !quality == !info->quality)
+		return;
+
+	info->quality = quality;
+	mb_menu_items_update (info);
 	applet_schedule_update_icon (info->applet);
-	applet_schedule_update_menu (info->applet);
 }
 
 static void
@@ -832,10 +844,18 @@ access_technologies_updated (GObject *object,
                              GParamSpec *pspec,
                              BroadbandDeviceInfo *info)
 {
+	guint32 act = broadband_act_to_mb_act (info);
+
+	if (act == info->act)
+		return;
+
+	info->act = act;
+	mb_menu_items_update (info);
 	applet_schedule_update_icon (info->applet);
-	applet_schedule_update_menu (info->applet);
 }
 
+static void providers_loaded (gpointer user_data);
+
 static void
 operator_info_updated (GObject *object,
                        GParamSpec *pspec,
@@ -848,17 +868,29 @@ operator_info_updated (GObject *object,
 
 	if (info->mm_modem_3gpp) {
 		info->operator_name = (mobile_helper_parse_3gpp_operator_name (
-			                       &(info->mpd),
 			                       mm_modem_3gpp_get_operator_name (info->mm_modem_3gpp),
-			                       mm_modem_3gpp_get_operator_code (info->mm_modem_3gpp)));
-		if (info->operator_name)
-			return;
+			                       mm_modem_3gpp_get_operator_code (info->mm_modem_3gpp),
+			                       providers_loaded,
+			                       info));
 	}
 
-	if (info->mm_modem_cdma)
+	if (!info->operator_name && info->mm_modem_cdma)
 		info->operator_name = (mobile_helper_parse_3gpp2_operator_name (
-			                       &(info->mpd),
-			                       mm_modem_cdma_get_sid (info->mm_modem_cdma)));
+			                       mm_modem_cdma_get_sid (info->mm_modem_cdma),
+			                       providers_loaded,
+			                       info));
+
+	mb_menu_items_update (info);
+}
+
+/* The operator name may have been shown as the MCC/MNC until now */
+static void
+providers_loaded (gpointer user_data)
+{
+	BroadbandDeviceInfo *info = user_data;
+
+	operator_info_updated (NULL, NULL, info);
+	applet_schedule_update_icon (info->applet);
 }
 
 static void
@@ -973,8 +1005,8 @@ broadband_device_info_free (BroadbandDeviceInfo *info)
 	setup_signals (info, FALSE);
 
 	g_free (info->operator_name);
-	if (info->mpd)
-		g_object_unref (info->mpd);
+	mobile_helper_providers_cancel (info);
+	applet_broadband_unlock_cancel (info);
 
 	if (info->mm_sim)
 		g_object_unref (info->mm_sim);
@@ -989,6 +1021,12 @@ broadband_device_info_free (BroadbandDeviceInfo *info)
 		unlock_dialog_destroy (info);
 	g_object_unref (info->cancellable);
 
+	/* Takes them out of the menu too; they're dropped when destroyed */
+	if (info->active_item)
+		gtk_widget_destroy (info->active_item);
+	if (info->status_item)
+		gtk_widget_destroy (info->status_item);
+
 	g_slice_free (BroadbandDeviceInfo, info);
 }
 
@@ -1045,8 +1083,10 @@ device_added (NMDevice *device,
 	                  info);
 
 	/* Load initial values */
-	signal_quality_updated (NULL, NULL, info);
-	access_technologies_updated (NULL, NULL, info);
+	info->quality = mm_modem_get_signal_quality (info->mm_modem, NULL);
+	info->act = broadband_act_to_mb_act (info);
+	applet_schedule_update_icon (info->applet);
+	applet_schedule_update_menu (info->applet);
 	if (mm_modem_get_state (info->mm_modem) >= MM_MODEM_STATE_ENABLED)
 		setup_signals (info, TRUE);
 
@@ -150,6 +150,8 @@ get_bt_secrets_cb (GtkDialog *dialog,
 	NMSetting *setting;
 	GError *error = NULL;
 
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_USER);
+
 	if (response == GTK_RESPONSE_OK) {
 		setting = nm_connection_get_setting_by_name (req->connection, req->setting_name);
 		if (setting) {
@@ -231,6 +233,8 @@ bt_get_secrets (SecretsRequest *req, GError **error)
 	gtk_window_set_position (GTK_WINDOW (widget), GTK_WIN_POS_CENTER_ALWAYS);
 	gtk_widget_realize (GTK_WIDGET (widget));
 	gtk_window_present (GTK_WINDOW (widget));
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_DIALOG_WAIT);
+	applet_secrets_request_stage_begin (req, APPLET_AGENT_STAGE_USER);
 
 	return TRUE;
 }
@@ -12,6 +12,7 @@
 #include "applet.h"
 #include "applet-device-ethernet.h"
 #include "ethernet-dialog.h"
+#include "utils.h"
 
 #define DEFAULT_ETHERNET_NAME _("Auto Ethernet")
 
@@ -263,6 +264,8 @@ get_pppoe_secrets_cb (GtkDialog *dialog, gint response, gpointer user_data)
 	GVariant *secrets = NULL;
 	GError *error = NULL;
 
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_USER);
+
 	if (response != GTK_RESPONSE_OK) {
 		g_set_error (&error,
 		             NM_SECRET_AGENT_ERROR,
@@ -275,7 +278,7 @@ get_pppoe_secrets_cb (GtkDialog *dialog, gint response, gpointer user_data)
 	setting = nm_connection_get_setting_pppoe (req->connection);
 	pppoe_update_setting (setting, info);
 
-	secrets = nm_connection_to_dbus (req->connection, NM_CONNECTION_SERIALIZE_ONLY_SECRETS);
+	secrets = utils_connection_secrets_to_dbus (req->connection, NM_SETTING_PPPOE_SETTING_NAME, NULL);
 	if (!secrets) {
 		g_set_error (&error,
 		             NM_SECRET_AGENT_ERROR,
@@ -356,6 +359,8 @@ pppoe_get_secrets (SecretsRequest *req, GError **error)
 	gtk_window_set_position (GTK_WINDOW (info->dialog), GTK_WIN_POS_CENTER_ALWAYS);
 	gtk_widget_realize (info->dialog);
 	gtk_window_present (GTK_WINDOW (info->dialog));
+	applet_secrets_request_stage_end (&info->req, APPLET_AGENT_STAGE_DIALOG_WAIT);
+	applet_secrets_request_stage_begin (&info->req, APPLET_AGENT_STAGE_USER);
 
 	return TRUE;
 }
@@ -387,6 +392,8 @@ get_8021x_secrets_cb (GtkDialog *dialog, gint response, gpointer user_data)
 	NMSetting *setting;
 	GError *error = NULL;
 
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_USER);
+
 	if (response != GTK_RESPONSE_OK) {
 		g_set_error (&error,
 		             NM_SECRET_AGENT_ERROR,
@@ -446,6 +453,8 @@ nm_8021x_get_secrets (SecretsRequest *req, GError **error)
 	gtk_window_set_position (GTK_WINDOW (info->dialog), GTK_WIN_POS_CENTER_ALWAYS);
 	gtk_widget_realize (info->dialog);
 	gtk_window_present (GTK_WINDOW (info->dialog));
+	applet_secrets_request_stage_end (&info->req, APPLET_AGENT_STAGE_DIALOG_WAIT);
+	applet_secrets_request_stage_begin (&info->req, APPLET_AGENT_STAGE_USER);
 
 	return TRUE;
 }
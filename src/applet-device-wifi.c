@@ -1435,30 +1435,6 @@ done:
 	gtk_widget_destroy (GTK_WIDGET (dialog));
 }
 
-static GVariant *
-remove_unwanted_secrets (GVariant *secrets, gboolean keep_8021X)
-{
-	GVariant *copy, *setting_dict;
-	const char *setting_name;
-	GVariantBuilder conn_builder;
-	GVariantIter conn_iter;
-
-	g_variant_builder_init (&conn_builder, NM_VARIANT_TYPE_CONNECTION);
-	g_variant_iter_init (&conn_iter, secrets);
-	while (g_variant_iter_next (&conn_iter, "{&s@a{sv}}", &setting_name, &setting_dict)) {
-		if (   !strcmp (setting_name, NM_SETTING_WIRELESS_SECURITY_SETTING_NAME)
-		    || (!strcmp (setting_name, NM_SETTING_802_1X_SETTING_NAME) && keep_8021X))
-			g_variant_builder_add (&conn_builder, "{s@a{sv}}", setting_name, setting_dict);
-
-		g_variant_unref (setting_dict);
-	}
-	copy = g_variant_builder_end (&conn_builder);
-	g_variant_unref (secrets);
-
-	return copy;
-}
-	
-
 typedef struct {
 	SecretsRequest req;
 
@@ -1492,6 +1468,8 @@ get_secrets_dialog_response_cb (GtkDialog *foo,
 	gboolean keep_8021X = FALSE;
 	GError *error = NULL;
 
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_USER);
+
 	if (response != GTK_RESPONSE_OK) {
 		g_set_error (&error,
 		             NM_SECRET_AGENT_ERROR,
@@ -1523,15 +1501,6 @@ get_secrets_dialog_response_cb (GtkDialog *foo,
 		goto done;  /* Unencrypted */
 	}
 
-	secrets = nm_connection_to_dbus (connection, NM_CONNECTION_SERIALIZE_ONLY_SECRETS);
-	if (!secrets) {
-		g_set_error (&error,
-		             NM_SECRET_AGENT_ERROR,
-		             NM_SECRET_AGENT_ERROR_FAILED,
-		             "%s.%d (%s): failed to hash connection '%s'.",
-		             __FILE__, __LINE__, __func__, nm_connection_get_id (connection));
-		goto done;
-	}
 	/* If the user chose an 802.1x-based auth method, return 802.1x secrets,
 	 * not wireless secrets.  Can happen with Dynamic WEP, because NM doesn't
 	 * know the capabilities of the AP (since Dynamic WEP APs don't broadcast
@@ -1559,8 +1528,19 @@ get_secrets_dialog_response_cb (GtkDialog *foo,
 		}
 	}
 
-	/* Remove all not-relevant secrets (inner dicts) */
-	secrets = remove_unwanted_secrets (secrets, keep_8021X);
+	/* Only return the relevant secrets */
+	secrets = utils_connection_secrets_to_dbus (connection,
+	                                            NM_SETTING_WIRELESS_SECURITY_SETTING_NAME,
+	                                            keep_8021X ? NM_SETTING_802_1X_SETTING_NAME : NULL,
+	                                            NULL);
+	if (!secrets) {
+		g_set_error (&error,
+		             NM_SECRET_AGENT_ERROR,
+		             NM_SECRET_AGENT_ERROR_FAILED,
+		             "%s.%d (%s): failed to hash connection '%s'.",
+		             __FILE__, __LINE__, __func__, nm_connection_get_id (connection));
+		goto done;
+	}
 	g_variant_take_ref (secrets);
 
 done:
@@ -1590,6 +1570,8 @@ wifi_get_secrets (SecretsRequest *req, GError **error)
 		                  G_CALLBACK (get_secrets_dialog_response_cb),
 		                  info);
 		show_ignore_focus_stealing_prevention (info->dialog);
+		applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_DIALOG_WAIT);
+		applet_secrets_request_stage_begin (req, APPLET_AGENT_STAGE_USER);
 	} else {
 		g_set_error (error,
 		             NM_SECRET_AGENT_ERROR,
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* Records the NMClient signals the applet reacts to, one JSON object per
+ * line, so that field conditions (roaming storms, VPN flaps, scan bursts)
+ * can be replayed against the stand-in NetworkManager in src/tests with
+ * replay-nm-trace.py.  The recording starts with a snapshot of the current
+ * devices, access points and active connections.
+ */
+
+#include "nm-default.h"
+
+#include <stdio.h>
+#include <errno.h>
+
+#include "applet-record.h"
+#include "applet-trace.h"
+
+static struct {
+	FILE *file;
+	gint64 start_time;
+	GString *line;
+} record;
+
+gboolean
+applet_record_enabled (void)
+{
+	return record.file != NULL;
+}
+
+static void
+record_begin (const char *event)
+{
+	g_string_printf (record.line, "{\"t_us\":%" G_GINT64_FORMAT ",\"event\":\"%s\"",
+	                 g_get_monotonic_time () - record.start_time, event);
+}
+
+static void
+record_string (const char *key, const char *value)
+{
+	g_string_append_printf (record.line, ",\"%s\":", key);
+	applet_trace_append_json_string (record.line, value ?: "");
+}
+
+static void
+record_uint (const char *key, guint value)
+{
+	g_string_append_printf (record.line, ",\"%s\":%u", key, value);
+}
+
+static void
+record_path (const char *key, gpointer object)
+{
+	record_string (key, object ? nm_object_get_path (NM_OBJECT (object)) : "/");
+}
+
+static void
+record_end (void)
+{
+	g_string_append (record.line, "}\n");
+	fwrite (record.line->str, 1, record.line->len, record.file);
+	fflush (record.file);
+}
+
+/*****************************************************************************/
+
+static void
+ap_strength_changed_cb (NMAccessPoint *ap, GParamSpec *pspec, gpointer user_data)
+{
+	if (!record.file)
+		return;
+
+	record_begin ("strength");
+	record_path ("ap", ap);
+	record_uint ("strength", nm_access_point_get_strength (ap));
+	record_end ();
+}
+
+static void
+record_ap_added (NMDeviceWifi *device, NMAccessPoint *ap)
+{
+	GBytes *ssid = nm_access_point_get_ssid (ap);
+	gs_free char *ssid_str = NULL;
+
+	if (ssid)
+		ssid_str = nm_utils_ssid_to_utf8 (g_bytes_get_data (ssid, NULL), g_bytes_get_size (ssid));
+
+	record_begin ("ap-added");
+	record_path ("device", device);
+	record_path ("ap", ap);
+	record_string ("ssid", ssid_str);
+	record_uint ("strength", nm_access_point_get_strength (ap));
+	record_end ();
+
+	g_signal_connect (ap, "notify::" NM_ACCESS_POINT_STRENGTH,
+	                  G_CALLBACK (ap_strength_changed_cb), NULL);
+}
+
+static void
+ap_added_cb (NMDeviceWifi *device, NMAccessPoint *ap, gpointer user_data)
+{
+	if (record.file)
+		record_ap_added (device, ap);
+}
+
+static void
+ap_removed_cb (NMDeviceWifi *device, NMAccessPoint *ap, gpointer user_data)
+{
+	if (!record.file)
+		return;
+
+	record_begin ("ap-removed");
+	record_path ("device", device);
+	record_path ("ap", ap);
+	record_end ();
+}
+
+static void
+device_state_changed_cb (NMDevice *device,
+                         NMDeviceState new_state,
+                         NMDeviceState old_state,
+                         NMDeviceStateReason reason,
+                         gpointer user_data)
+{
+	if (!record.file)
+		return;
+
+	record_begin ("state-changed");
+	record_path ("device", device);
+	record_uint ("state", new_state);
+	record_uint ("old-state", old_state);
+	record_uint ("reason", reason);
+	record_end ();
+}
+
+static void
+record_device_added (NMDevice *device)
+{
+	record_begin ("device-added");
+	record_path ("device", device);
+	record_string ("iface", nm_device_get_iface (device));
+	record_uint ("device-type", nm_device_get_device_type (device));
+	record_uint ("state", nm_device_get_state (device));
+	record_end ();
+
+	g_signal_connect (device, "state-changed",
+	                  G_CALLBACK (device_state_changed_cb), NULL);
+
+	if (NM_IS_DEVICE_WIFI (device)) {
+		const GPtrArray *aps = nm_device_wifi_get_access_points (NM_DEVICE_WIFI (device));
+		guint i;
+
+		for (i = 0; aps && i < aps->len; i++)
+			record_ap_added (NM_DEVICE_WIFI (device), aps->pdata[i]);
+
+		g_signal_connect (device, "access-point-added",
+		                  G_CALLBACK (ap_added_cb), NULL);
+		g_signal_connect (device, "access-point-removed",
+		                  G_CALLBACK (ap_removed_cb), NULL);
+	}
+}
+
+static void
+device_added_cb (NMClient *client, NMDevice *device, gpointer user_data)
+{
+	if (record.file)
+		record_device_added (device);
+}
+
+static void
+device_removed_cb (NMClient *client, NMDevice *device, gpointer user_data)
+{
+	if (!record.file)
+		return;
+
+	record_begin ("device-removed");
+	record_path ("device", device);
+	record_end ();
+}
+
+static void
+record_active_connections (NMClient *client)
+{
+	const GPtrArray *active_list = nm_client_get_active_connections (client);
+	guint i;
+
+	record_begin ("active-connections");
+	g_string_append (record.line, ",\"active\":[");
+	for (i = 0; active_list && i < active_list->len; i++) {
+		NMActiveConnection *active = active_list->pdata[i];
+		const GPtrArray *devices = nm_active_connection_get_devices (active);
+
+		if (i > 0)
+			g_string_append_c (record.line, ',');
+		g_string_append (record.line, "{\"path\":");
+		applet_trace_append_json_string (record.line, nm_object_get_path (NM_OBJECT (active)));
+		g_string_append (record.line, ",\"id\":");
+		applet_trace_append_json_string (record.line, nm_active_connection_get_id (active) ?: "");
+		g_string_append (record.line, ",\"type\":");
+		applet_trace_append_json_string (record.line, nm_active_connection_get_connection_type (active) ?: "");
+		g_string_append (record.line, ",\"device\":");
+		applet_trace_append_json_string (record.line,
+		                                 devices && devices->len
+		                                 ? nm_object_get_path (devices->pdata[0])
+		                                 : "/");
+		g_string_append_c (record.line, '}');
+	}
+	g_string_append_c (record.line, ']');
+	record_end ();
+}
+
+static void
+active_connections_changed_cb (NMClient *client, GParamSpec *pspec, gpointer user_data)
+{
+	if (record.file)
+		record_active_connections (client);
+}
+
+/**
+ * applet_record_attach:
+ * @client: the applet's #NMClient
+ *
+ * Writes a snapshot of @client's current state to the recording and starts
+ * following changes to it. Does nothing unless applet_record_init() was
+ * called.
+ */
+void
+applet_record_attach (NMClient *client)
+{
+	const GPtrArray *devices;
+	guint i;
+
+	if (!record.file)
+		return;
+
+	devices = nm_client_get_devices (client);
+	for (i = 0; devices && i < devices->len; i++)
+		record_device_added (devices->pdata[i]);
+	record_active_connections (client);
+
+	/* lets the replay set up the initial state before starting the applet */
+	record_begin ("snapshot-end");
+	record_end ();
+
+	g_signal_connect (client, "device-added",
+	                  G_CALLBACK (device_added_cb), NULL);
+	g_signal_connect (client, "device-removed",
+	                  G_CALLBACK (device_removed_cb), NULL);
+	g_signal_connect (client, "notify::" NM_CLIENT_ACTIVE_CONNECTIONS,
+	                  G_CALLBACK (active_connections_changed_cb), NULL);
+}
+
+void
+applet_record_init (const char *filename)
+{
+	g_return_if_fail (!record.file);
+	g_return_if_fail (filename && *filename);
+
+	record.file = fopen (filename, "we");
+	if (!record.file) {
+		g_warning ("Could not open %s for recording: %s", filename, g_strerror (errno));
+		return;
+	}
+
+	record.start_time = g_get_monotonic_time ();
+	record.line = g_string_sized_new (256);
+
+	g_message ("Recording NetworkManager events to %s", filename);
+}
+
+void
+applet_record_shutdown (void)
+{
+	if (!record.file)
+		return;
+
+	fclose (record.file);
+	record.file = NULL;
+	g_string_free (record.line, TRUE);
+	record.line = NULL;
+}
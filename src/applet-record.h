@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_RECORD_H
+#define APPLET_RECORD_H
+
+#include <NetworkManager.h>
+
+void     applet_record_init (const char *filename);
+void     applet_record_shutdown (void);
+gboolean applet_record_enabled (void);
+
+void     applet_record_attach (NMClient *client);
+
+#endif  /* APPLET_RECORD_H */
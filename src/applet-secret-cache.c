@@ -0,0 +1,466 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* A short-lived cache of the secrets read from the keyring, so that
+ * NetworkManager re-requesting the same secrets on every reassociation does
+ * not cost a Secret Service round trip each time.  It is disabled unless a
+ * timeout is set.
+ *
+ * Secrets are kept serialized in memory that is locked (never swapped out),
+ * excluded from core dumps and zeroed before it is released.  If locking the
+ * memory fails, nothing is cached.
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "applet-secret-cache.h"
+
+typedef struct {
+	char *uuid;
+	char *setting_name;
+	char *fingerprint;
+	gint64 expires;
+
+	/* the serialized a{sv}, in locked memory */
+	guint8 *data;
+	gsize len;
+	gsize mapped_len;
+} CacheEntry;
+
+struct _AppletSecretCache {
+	GHashTable *entries;
+	guint timeout_sec;
+	guint purge_id;
+
+	struct {
+		guint64 hits;
+		guint64 misses;
+		guint64 inserts;
+		guint64 expired;
+		guint64 invalidated;
+		guint64 lock_failures;
+	} stats;
+};
+
+static guint8 *
+locked_alloc (gsize len, gsize *out_mapped_len)
+{
+	gsize page_size = sysconf (_SC_PAGESIZE);
+	gsize mapped_len = MAX (1, (len + page_size - 1) / page_size) * page_size;
+	void *mem;
+
+	mem = mmap (NULL, mapped_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+
+	if (mlock (mem, mapped_len) != 0) {
+		munmap (mem, mapped_len);
+		return NULL;
+	}
+
+#ifdef MADV_DONTDUMP
+	madvise (mem, mapped_len, MADV_DONTDUMP);
+#endif
+#ifdef MADV_DONTFORK
+	madvise (mem, mapped_len, MADV_DONTFORK);
+#endif
+
+	*out_mapped_len = mapped_len;
+	return mem;
+}
+
+static void
+locked_free (guint8 *mem, gsize mapped_len)
+{
+	volatile guint8 *p = mem;
+	gsize i;
+
+	/* Through a volatile pointer, so that it's not optimized away */
+	for (i = 0; i < mapped_len; i++)
+		p[i] = 0;
+
+	munlock (mem, mapped_len);
+	munmap (mem, mapped_len);
+}
+
+typedef struct {
+	guint8 *data;
+	gsize mapped_len;
+} LockedCopy;
+
+static void
+locked_copy_free (gpointer data)
+{
+	LockedCopy *copy = data;
+
+	locked_free (copy->data, copy->mapped_len);
+	g_slice_free (LockedCopy, copy);
+}
+
+/* Hands out the secrets in locked memory of their own, zeroed when the
+ * variant is released, rather than copying them to the heap. */
+static GVariant *
+entry_to_variant (AppletSecretCache *cache, CacheEntry *entry)
+{
+	LockedCopy *copy;
+	gsize mapped_len;
+	guint8 *data;
+
+	data = locked_alloc (entry->len, &mapped_len);
+	if (!data) {
+		cache->stats.lock_failures++;
+		return NULL;
+	}
+	memcpy (data, entry->data, entry->len);
+
+	copy = g_slice_new (LockedCopy);
+	copy->data = data;
+	copy->mapped_len = mapped_len;
+
+	return g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
+	                                data,
+	                                entry->len,
+	                                FALSE,
+	                                locked_copy_free,
+	                                copy);
+}
+
+static void
+cache_entry_free (gpointer data)
+{
+	CacheEntry *entry = data;
+
+	locked_free (entry->data, entry->mapped_len);
+	g_free (entry->uuid);
+	g_free (entry->setting_name);
+	g_free (entry->fingerprint);
+	g_slice_free (CacheEntry, entry);
+}
+
+static char *
+cache_key (const char *uuid, const char *setting_name)
+{
+	return g_strdup_printf ("%s/%s", uuid, setting_name);
+}
+
+/*****************************************************************************/
+
+static void schedule_purge (AppletSecretCache *cache);
+
+static gboolean
+purge_cb (gpointer user_data)
+{
+	AppletSecretCache *cache = user_data;
+	gint64 now = g_get_monotonic_time ();
+	GHashTableIter iter;
+	CacheEntry *entry;
+
+	cache->purge_id = 0;
+
+	g_hash_table_iter_init (&iter, cache->entries);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &entry)) {
+		if (entry->expires <= now) {
+			g_hash_table_iter_remove (&iter);
+			cache->stats.expired++;
+		}
+	}
+
+	schedule_purge (cache);
+	return G_SOURCE_REMOVE;
+}
+
+/* Expired secrets shouldn't linger until the next lookup, so drop them from a
+ * timeout at the earliest expiration. */
+static void
+schedule_purge (AppletSecretCache *cache)
+{
+	GHashTableIter iter;
+	CacheEntry *entry;
+	gint64 earliest = G_MAXINT64;
+
+	if (cache->purge_id)
+		return;
+
+	g_hash_table_iter_init (&iter, cache->entries);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &entry))
+		earliest = MIN (earliest, entry->expires);
+
+	if (earliest == G_MAXINT64)
+		return;
+
+	cache->purge_id = g_timeout_add (MAX (0, earliest - g_get_monotonic_time ()) / 1000 + 1,
+	                                 purge_cb, cache);
+}
+
+/*****************************************************************************/
+
+/**
+ * applet_secret_cache_lookup:
+ * @cache: the cache
+ * @uuid: the connection UUID
+ * @setting_name: the setting the secrets are for
+ * @fingerprint: identifies the non-secret part of the connection the secrets
+ *   were read for; a cached entry with a different one is not used
+ *
+ * Returns: (transfer full): the cached secrets as a floating a{sv}, or %NULL
+ */
+GVariant *
+applet_secret_cache_lookup (AppletSecretCache *cache,
+                            const char *uuid,
+                            const char *setting_name,
+                            const char *fingerprint)
+{
+	gs_free char *key = NULL;
+	CacheEntry *entry;
+	GVariant *secrets;
+
+	g_return_val_if_fail (cache, NULL);
+
+	if (!cache->timeout_sec)
+		return NULL;
+
+	key = cache_key (uuid, setting_name);
+	entry = g_hash_table_lookup (cache->entries, key);
+	if (entry && entry->expires <= g_get_monotonic_time ()) {
+		g_hash_table_remove (cache->entries, key);
+		cache->stats.expired++;
+		entry = NULL;
+	}
+
+	if (!entry || g_strcmp0 (entry->fingerprint, fingerprint)) {
+		cache->stats.misses++;
+		return NULL;
+	}
+
+	secrets = entry_to_variant (cache, entry);
+	if (!secrets) {
+		cache->stats.misses++;
+		return NULL;
+	}
+
+	cache->stats.hits++;
+	return secrets;
+}
+
+/**
+ * applet_secret_cache_lookup_connection:
+ * @cache: the cache
+ * @uuid: the connection UUID
+ * @fingerprint: as for applet_secret_cache_lookup()
+ *
+ * Returns: (transfer full): the cached secrets of all settings of the
+ *   connection as a floating a{sa{sv}}, or %NULL if there are none
+ */
+GVariant *
+applet_secret_cache_lookup_connection (AppletSecretCache *cache,
+                                       const char *uuid,
+                                       const char *fingerprint)
+{
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	CacheEntry *entry;
+	GVariant *secrets;
+	gint64 now = g_get_monotonic_time ();
+	gboolean found = FALSE;
+
+	g_return_val_if_fail (cache, NULL);
+
+	if (!cache->timeout_sec)
+		return NULL;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+	g_hash_table_iter_init (&iter, cache->entries);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &entry)) {
+		if (   g_strcmp0 (entry->uuid, uuid)
+		    || g_strcmp0 (entry->fingerprint, fingerprint)
+		    || entry->expires <= now)
+			continue;
+
+		secrets = entry_to_variant (cache, entry);
+		if (!secrets)
+			continue;
+
+		g_variant_builder_add (&builder, "{s@a{sv}}", entry->setting_name, secrets);
+		found = TRUE;
+	}
+
+	if (!found) {
+		g_variant_builder_clear (&builder);
+		cache->stats.misses++;
+		return NULL;
+	}
+
+	cache->stats.hits++;
+	return g_variant_builder_end (&builder);
+}
+
+void
+applet_secret_cache_insert (AppletSecretCache *cache,
+                            const char *uuid,
+                            const char *setting_name,
+                            const char *fingerprint,
+                            GVariant *secrets)
+{
+	CacheEntry *entry;
+	gsize mapped_len;
+	guint8 *data;
+	gsize len;
+
+	g_return_if_fail (cache);
+	g_return_if_fail (g_variant_is_of_type (secrets, G_VARIANT_TYPE_VARDICT));
+
+	if (!cache->timeout_sec)
+		return;
+
+	len = g_variant_get_size (secrets);
+	data = locked_alloc (len, &mapped_len);
+	if (!data) {
+		if (!cache->stats.lock_failures++)
+			g_debug ("Could not lock memory for the secret cache; not caching secrets");
+		return;
+	}
+	g_variant_store (secrets, data);
+
+	entry = g_slice_new0 (CacheEntry);
+	entry->uuid = g_strdup (uuid);
+	entry->setting_name = g_strdup (setting_name);
+	entry->fingerprint = g_strdup (fingerprint);
+	entry->expires = g_get_monotonic_time () + (gint64) cache->timeout_sec * G_USEC_PER_SEC;
+	entry->data = data;
+	entry->len = len;
+	entry->mapped_len = mapped_len;
+
+	g_hash_table_insert (cache->entries, cache_key (uuid, setting_name), entry);
+	cache->stats.inserts++;
+
+	schedule_purge (cache);
+}
+
+/**
+ * applet_secret_cache_invalidate:
+ * @cache: the cache
+ * @uuid: the connection UUID
+ *
+ * Drops all cached secrets of the connection.
+ */
+void
+applet_secret_cache_invalidate (AppletSecretCache *cache, const char *uuid)
+{
+	GHashTableIter iter;
+	CacheEntry *entry;
+
+	g_return_if_fail (cache);
+
+	g_hash_table_iter_init (&iter, cache->entries);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &entry)) {
+		if (!g_strcmp0 (entry->uuid, uuid)) {
+			g_hash_table_iter_remove (&iter);
+			cache->stats.invalidated++;
+		}
+	}
+}
+
+void
+applet_secret_cache_clear (AppletSecretCache *cache)
+{
+	g_return_if_fail (cache);
+
+	g_hash_table_remove_all (cache->entries);
+	nm_clear_g_source (&cache->purge_id);
+}
+
+/**
+ * applet_secret_cache_set_timeout:
+ * @cache: the cache
+ * @timeout_sec: how long secrets are kept, 0 disables the cache
+ */
+void
+applet_secret_cache_set_timeout (AppletSecretCache *cache, guint timeout_sec)
+{
+	g_return_if_fail (cache);
+
+	if (cache->timeout_sec == timeout_sec)
+		return;
+
+	/* Start over rather than re-timing the existing entries */
+	applet_secret_cache_clear (cache);
+	cache->timeout_sec = timeout_sec;
+}
+
+/**
+ * applet_secret_cache_is_enabled:
+ * @cache: the cache
+ *
+ * Returns: whether secrets are cached at all, so that callers can skip
+ *   computing the fingerprint when they aren't
+ */
+gboolean
+applet_secret_cache_is_enabled (AppletSecretCache *cache)
+{
+	g_return_val_if_fail (cache, FALSE);
+
+	return cache->timeout_sec > 0;
+}
+
+GVariant *
+applet_secret_cache_get_statistics (AppletSecretCache *cache)
+{
+	GVariantBuilder builder;
+
+	g_return_val_if_fail (cache, NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "timeout-sec",
+	                       g_variant_new_uint32 (cache->timeout_sec));
+	g_variant_builder_add (&builder, "{sv}", "entries",
+	                       g_variant_new_uint32 (g_hash_table_size (cache->entries)));
+	g_variant_builder_add (&builder, "{sv}", "hits",
+	                       g_variant_new_uint64 (cache->stats.hits));
+	g_variant_builder_add (&builder, "{sv}", "misses",
+	                       g_variant_new_uint64 (cache->stats.misses));
+	g_variant_builder_add (&builder, "{sv}", "inserts",
+	                       g_variant_new_uint64 (cache->stats.inserts));
+	g_variant_builder_add (&builder, "{sv}", "expired",
+	                       g_variant_new_uint64 (cache->stats.expired));
+	g_variant_builder_add (&builder, "{sv}", "invalidated",
+	                       g_variant_new_uint64 (cache->stats.invalidated));
+	g_variant_builder_add (&builder, "{sv}", "lock-failures",
+	                       g_variant_new_uint64 (cache->stats.lock_failures));
+	return g_variant_builder_end (&builder);
+}
+
+void
+applet_secret_cache_reset_statistics (AppletSecretCache *cache)
+{
+	g_return_if_fail (cache);
+
+	memset (&cache->stats, 0, sizeof (cache->stats));
+}
+
+AppletSecretCache *
+applet_secret_cache_new (void)
+{
+	AppletSecretCache *cache;
+
+	cache = g_slice_new0 (AppletSecretCache);
+	cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, cache_entry_free);
+	return cache;
+}
+
+void
+applet_secret_cache_free (AppletSecretCache *cache)
+{
+	if (!cache)
+		return;
+
+	applet_secret_cache_clear (cache);
+	g_hash_table_unref (cache->entries);
+	g_slice_free (AppletSecretCache, cache);
+}
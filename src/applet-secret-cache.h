@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_SECRET_CACHE_H
+#define APPLET_SECRET_CACHE_H
+
+#include <glib.h>
+
+typedef struct _AppletSecretCache AppletSecretCache;
+
+AppletSecretCache *applet_secret_cache_new (void);
+void               applet_secret_cache_free (AppletSecretCache *cache);
+
+void               applet_secret_cache_set_timeout (AppletSecretCache *cache,
+                                                    guint timeout_sec);
+gboolean           applet_secret_cache_is_enabled (AppletSecretCache *cache);
+
+GVariant          *applet_secret_cache_lookup (AppletSecretCache *cache,
+                                               const char *uuid,
+                                               const char *setting_name,
+                                               const char *fingerprint);
+
+GVariant          *applet_secret_cache_lookup_connection (AppletSecretCache *cache,
+                                                          const char *uuid,
+                                                          const char *fingerprint);
+
+void               applet_secret_cache_insert (AppletSecretCache *cache,
+                                               const char *uuid,
+                                               const char *setting_name,
+                                               const char *fingerprint,
+                                               GVariant *secrets);
+
+void               applet_secret_cache_invalidate (AppletSecretCache *cache,
+                                                   const char *uuid);
+
+void               applet_secret_cache_clear (AppletSecretCache *cache);
+
+GVariant          *applet_secret_cache_get_statistics (AppletSecretCache *cache);
+void               applet_secret_cache_reset_statistics (AppletSecretCache *cache);
+
+#endif  /* APPLET_SECRET_CACHE_H */
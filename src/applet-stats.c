@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "applet-stats.h"
+
+void
+applet_histogram_add (AppletHistogram *histogram, gint64 usec)
+{
+	guint64 bound = APPLET_HISTOGRAM_BASE_US;
+	guint i;
+
+	if (usec < 0)
+		usec = 0;
+
+	for (i = 0; i < APPLET_HISTOGRAM_BUCKETS - 1; i++) {
+		if ((guint64) usec < bound)
+			break;
+		bound <<= 1;
+	}
+
+	histogram->buckets[i]++;
+	histogram->count++;
+	histogram->sum += usec;
+	histogram->max = MAX (histogram->max, (guint64) usec);
+}
+
+void
+applet_histogram_reset (AppletHistogram *histogram)
+{
+	memset (histogram, 0, sizeof (*histogram));
+}
+
+/**
+ * applet_histogram_to_variant:
+ * @histogram: the histogram
+ *
+ * Returns: (transfer floating): an a{sv} dictionary with the sample count,
+ *   sum and maximum (in microseconds), the upper bounds of the buckets
+ *   (the last bucket has none) and the per-bucket counts.
+ */
+GVariant *
+applet_histogram_to_variant (const AppletHistogram *histogram)
+{
+	GVariantBuilder builder, bounds, buckets;
+	guint64 bound = APPLET_HISTOGRAM_BASE_US;
+	guint i;
+
+	g_variant_builder_init (&bounds, G_VARIANT_TYPE ("at"));
+	g_variant_builder_init (&buckets, G_VARIANT_TYPE ("au"));
+	for (i = 0; i < APPLET_HISTOGRAM_BUCKETS; i++) {
+		if (i < APPLET_HISTOGRAM_BUCKETS - 1) {
+			g_variant_builder_add (&bounds, "t", bound);
+			bound <<= 1;
+		}
+		g_variant_builder_add (&buckets, "u", histogram->buckets[i]);
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "count", g_variant_new_uint64 (histogram->count));
+	g_variant_builder_add (&builder, "{sv}", "sum-us", g_variant_new_uint64 (histogram->sum));
+	g_variant_builder_add (&builder, "{sv}", "max-us", g_variant_new_uint64 (histogram->max));
+	g_variant_builder_add (&builder, "{sv}", "bucket-bounds-us", g_variant_builder_end (&bounds));
+	g_variant_builder_add (&builder, "{sv}", "buckets", g_variant_builder_end (&buckets));
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * applet_get_rss_kb:
+ *
+ * Returns: the resident set size of the process in KiB, or 0 if unknown
+ */
+guint64
+applet_get_rss_kb (void)
+{
+	gs_free char *contents = NULL;
+	guint64 pages;
+	char *end;
+
+	if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+		return 0;
+
+	/* The total size comes first, then the resident one, in pages */
+	end = strchr (contents, ' ');
+	if (!end)
+		return 0;
+	pages = g_ascii_strtoull (end + 1, NULL, 10);
+
+	return pages * sysconf (_SC_PAGESIZE) / 1024;
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_STATS_H
+#define APPLET_STATS_H
+
+#include <glib.h>
+
+/* Bucket 0 counts samples below APPLET_HISTOGRAM_BASE_US microseconds, each
+ * following bucket doubles the upper bound; the last one is open-ended. */
+#define APPLET_HISTOGRAM_BUCKETS 16
+#define APPLET_HISTOGRAM_BASE_US 128
+
+typedef struct {
+	guint64 count;
+	guint64 sum;
+	guint64 max;
+	guint32 buckets[APPLET_HISTOGRAM_BUCKETS];
+} AppletHistogram;
+
+void      applet_histogram_add (AppletHistogram *histogram, gint64 usec);
+
+void      applet_histogram_reset (AppletHistogram *histogram);
+
+GVariant *applet_histogram_to_variant (const AppletHistogram *histogram);
+
+guint64   applet_get_rss_kb (void);
+
+#endif  /* APPLET_STATS_H */
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* A tiny in-process recorder for timing events, written out in the Chrome
+ * trace-event JSON format (load it in chrome://tracing or Perfetto).
+ * Events are kept in a fixed-size ring buffer so that a long-running applet
+ * only ever holds the most recent ones.
+ */
+
+#include "nm-default.h"
+
+#include <signal.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "applet-trace.h"
+
+#define TRACE_MAX_EVENTS 32768
+
+typedef struct {
+	const char *category;
+	const char *name;
+	gint64 timestamp;
+	gint64 duration;
+	gconstpointer id;
+	char phase;
+} TraceEvent;
+
+static struct {
+	char *filename;
+	TraceEvent *events;
+	guint head;
+	guint len;
+	guint sigusr1_id;
+} trace;
+
+gboolean
+applet_trace_enabled (void)
+{
+	return trace.events != NULL;
+}
+
+static void
+trace_add (char phase,
+           const char *category,
+           const char *name,
+           gint64 timestamp,
+           gint64 duration,
+           gconstpointer id)
+{
+	TraceEvent *event;
+
+	if (!trace.events)
+		return;
+
+	event = &trace.events[(trace.head + trace.len) % TRACE_MAX_EVENTS];
+	if (trace.len < TRACE_MAX_EVENTS)
+		trace.len++;
+	else
+		trace.head = (trace.head + 1) % TRACE_MAX_EVENTS;
+
+	event->phase = phase;
+	event->category = category;
+	event->name = name;
+	event->timestamp = timestamp;
+	event->duration = duration;
+	event->id = id;
+}
+
+void
+applet_trace_complete (const char *category,
+                       const char *name,
+                       gint64 start_time,
+                       gint64 end_time)
+{
+	trace_add ('X', category, name, start_time, end_time - start_time, NULL);
+}
+
+void
+applet_trace_instant (const char *category, const char *name)
+{
+	if (trace.events)
+		trace_add ('i', category, name, g_get_monotonic_time (), 0, NULL);
+}
+
+void
+applet_trace_async_begin (const char *category, const char *name, gconstpointer id)
+{
+	if (trace.events)
+		trace_add ('b', category, name, g_get_monotonic_time (), 0, id);
+}
+
+void
+applet_trace_async_end (const char *category, const char *name, gconstpointer id)
+{
+	if (trace.events)
+		trace_add ('e', category, name, g_get_monotonic_time (), 0, id);
+}
+
+void
+applet_trace_append_json_string (GString *str, const char *value)
+{
+	const char *p;
+
+	g_string_append_c (str, '"');
+	for (p = value; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			g_string_append_c (str, '\\');
+		if ((guchar) *p < 0x20)
+			g_string_append_printf (str, "\\u%04x", (guint) *p);
+		else
+			g_string_append_c (str, *p);
+	}
+	g_string_append_c (str, '"');
+}
+
+gboolean
+applet_trace_write (GError **error)
+{
+	gs_free char *dirname = NULL;
+	GString *str;
+	gboolean success;
+	int pid = getpid ();
+	guint i;
+
+	if (!trace.events)
+		return TRUE;
+
+	str = g_string_sized_new (trace.len * 96 + 64);
+	g_string_append (str, "{\"traceEvents\":[\n");
+
+	for (i = 0; i < trace.len; i++) {
+		const TraceEvent *event = &trace.events[(trace.head + i) % TRACE_MAX_EVENTS];
+
+		if (i > 0)
+			g_string_append (str, ",\n");
+		g_string_append (str, "{\"name\":");
+		applet_trace_append_json_string (str, event->name);
+		g_string_append (str, ",\"cat\":");
+		applet_trace_append_json_string (str, event->category);
+		g_string_append_printf (str, ",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d",
+		                        event->phase, event->timestamp, pid, pid);
+		switch (event->phase) {
+		case 'X':
+			g_string_append_printf (str, ",\"dur\":%" G_GINT64_FORMAT, event->duration);
+			break;
+		case 'i':
+			g_string_append (str, ",\"s\":\"p\"");
+			break;
+		case 'b':
+		case 'e':
+			g_string_append_printf (str, ",\"id\":\"%p\"", event->id);
+			break;
+		}
+		g_string_append_c (str, '}');
+	}
+
+	g_string_append (str, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	dirname = g_path_get_dirname (trace.filename);
+	g_mkdir_with_parents (dirname, 0700);
+
+	success = g_file_set_contents (trace.filename, str->str, str->len, error);
+	g_string_free (str, TRUE);
+	return success;
+}
+
+static gboolean
+trace_sigusr1_cb (gpointer user_data)
+{
+	gs_free_error GError *error = NULL;
+
+	if (applet_trace_write (&error))
+		g_message ("Trace written to %s", trace.filename);
+	else
+		g_warning ("Could not write trace: %s", error->message);
+
+	return G_SOURCE_CONTINUE;
+}
+
+/**
+ * applet_trace_init:
+ * @filename: (allow-none): where to write the trace to; if %NULL, a file
+ *   in the user's cache directory is used
+ *
+ * Enables recording of trace events. The recorded events are written out on
+ * SIGUSR1 and by applet_trace_shutdown().
+ */
+void
+applet_trace_init (const char *filename)
+{
+	g_return_if_fail (!trace.events);
+
+	if (filename && *filename)
+		trace.filename = g_strdup (filename);
+	else
+		trace.filename = g_build_filename (g_get_user_cache_dir (), "nm-applet-trace.json", NULL);
+
+	trace.events = g_new0 (TraceEvent, TRACE_MAX_EVENTS);
+	trace.sigusr1_id = g_unix_signal_add (SIGUSR1, trace_sigusr1_cb, NULL);
+
+	g_message ("Tracing enabled, writing to %s", trace.filename);
+}
+
+void
+applet_trace_shutdown (void)
+{
+	gs_free_error GError *error = NULL;
+
+	if (!trace.events)
+		return;
+
+	if (!applet_trace_write (&error))
+		g_warning ("Could not write trace: %s", error->message);
+
+	nm_clear_g_source (&trace.sigusr1_id);
+	g_clear_pointer (&trace.events, g_free);
+	g_clear_pointer (&trace.filename, g_free);
+	trace.head = 0;
+	trace.len = 0;
+}
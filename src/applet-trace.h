@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_TRACE_H
+#define APPLET_TRACE_H
+
+#include <glib.h>
+
+/* Category and event names must be string literals (or otherwise outlive the
+ * process); they are stored by pointer. */
+
+void     applet_trace_init (const char *filename);
+void     applet_trace_shutdown (void);
+gboolean applet_trace_enabled (void);
+gboolean applet_trace_write (GError **error);
+
+void     applet_trace_complete (const char *category,
+                                const char *name,
+                                gint64 start_time,
+                                gint64 end_time);
+
+void     applet_trace_instant (const char *category,
+                               const char *name);
+
+void     applet_trace_async_begin (const char *category,
+                                   const char *name,
+                                   gconstpointer id);
+
+void     applet_trace_async_end (const char *category,
+                                 const char *name,
+                                 gconstpointer id);
+
+void     applet_trace_append_json_string (GString *str,
+                                          const char *value);
+
+#endif  /* APPLET_TRACE_H */
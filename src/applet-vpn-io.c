@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* Talks to a VPN auth dialog over its stdin and stdout without blocking the
+ * main loop: the input is written in chunks as the pipe drains, while the
+ * output is read, and handed out, a line at a time.  Both go on at once, so
+ * a dialog that starts answering before it has read everything doesn't
+ * deadlock with us.
+ */
+
+#include "nm-default.h"
+
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include "applet-vpn-io.h"
+
+#define WRITE_CHUNK_SIZE 16384
+
+struct _AppletVpnIo {
+	GOutputStream *output;
+	GDataInputStream *input;
+	GCancellable *cancellable;
+	guint timeout_id;
+
+	GBytes *data;
+	gsize written;
+	gboolean eof;
+
+	AppletVpnIoLineFunc line_func;
+	AppletVpnIoDoneFunc done_func;
+	gpointer user_data;
+};
+
+static void write_next (AppletVpnIo *io);
+static void read_next (AppletVpnIo *io);
+
+/* Stops whatever is still going on and reports to the user, who may free @io,
+ * so it must not be touched afterwards. */
+static void
+finish (AppletVpnIo *io, GError *error)
+{
+	nm_clear_g_source (&io->timeout_id);
+	g_cancellable_cancel (io->cancellable);
+	io->done_func (error, io->user_data);
+}
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+	AppletVpnIo *io = user_data;
+	gs_free_error GError *error = NULL;
+
+	io->timeout_id = 0;
+	error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+	                             "The VPN authentication dialog timed out");
+	finish (io, error);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+write_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	AppletVpnIo *io = user_data;
+	gs_free_error GError *error = NULL;
+	gssize n;
+
+	n = g_output_stream_write_finish (G_OUTPUT_STREAM (source), result, &error);
+	if (n < 0) {
+		/* When cancelled, @io is already gone */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			return;
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE)) {
+			/* Dialogs stop reading at "DONE"; what they answer and
+			 * their exit status tell whether they got what they need. */
+			io->written = g_bytes_get_size (io->data);
+			write_next (io);
+			return;
+		}
+		g_prefix_error (&error, "Failed to write connection to VPN UI: ");
+		finish (io, error);
+		return;
+	}
+
+	io->written += n;
+	write_next (io);
+}
+
+static void
+write_next (AppletVpnIo *io)
+{
+	gsize len;
+	const guint8 *data = g_bytes_get_data (io->data, &len);
+
+	if (io->written < len) {
+		g_output_stream_write_async (io->output,
+		                             data + io->written,
+		                             MIN (len - io->written, WRITE_CHUNK_SIZE),
+		                             G_PRIORITY_DEFAULT,
+		                             io->cancellable,
+		                             write_cb,
+		                             io);
+		return;
+	}
+
+	/* The dialog reads until it sees the end of its input */
+	g_output_stream_close (io->output, NULL, NULL);
+	g_clear_object (&io->output);
+
+	if (io->eof)
+		finish (io, NULL);
+}
+
+static void
+read_line_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	AppletVpnIo *io = user_data;
+	gs_free_error GError *error = NULL;
+	gs_free char *line = NULL;
+	gsize len;
+
+	line = g_data_input_stream_read_line_finish (G_DATA_INPUT_STREAM (source), result, &len, &error);
+	if (error) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			return;
+		finish (io, error);
+		return;
+	}
+
+	if (!line) {
+		io->eof = TRUE;
+		if (!io->output)
+			finish (io, NULL);
+		return;
+	}
+
+	if (!io->line_func (line, len, io->user_data, &error)) {
+		finish (io, error);
+		return;
+	}
+
+	read_next (io);
+}
+
+static void
+read_next (AppletVpnIo *io)
+{
+	g_data_input_stream_read_line_async (io->input,
+	                                     G_PRIORITY_DEFAULT,
+	                                     io->cancellable,
+	                                     read_line_cb,
+	                                     io);
+}
+
+/**
+ * applet_vpn_io_new:
+ * @stdin_fd: the write end of the dialog's stdin, taken over
+ * @stdout_fd: the read end of the dialog's stdout, taken over
+ * @input: what to write to the dialog
+ * @timeout_sec: how long the whole exchange may take, 0 for no limit
+ * @line_func: called for each line the dialog writes
+ * @done_func: called when done
+ * @user_data: passed to @line_func and @done_func
+ *
+ * Starts writing @input to the dialog and reading its output.
+ *
+ * Returns: the new I/O, to be freed with applet_vpn_io_free(), which
+ *   cancels it if still ongoing
+ */
+AppletVpnIo *
+applet_vpn_io_new (int stdin_fd,
+                   int stdout_fd,
+                   GBytes *input,
+                   guint timeout_sec,
+                   AppletVpnIoLineFunc line_func,
+                   AppletVpnIoDoneFunc done_func,
+                   gpointer user_data)
+{
+	AppletVpnIo *io;
+	gs_unref_object GInputStream *base = NULL;
+
+	g_return_val_if_fail (stdin_fd >= 0, NULL);
+	g_return_val_if_fail (stdout_fd >= 0, NULL);
+	g_return_val_if_fail (input, NULL);
+	g_return_val_if_fail (line_func, NULL);
+	g_return_val_if_fail (done_func, NULL);
+
+	/* A large write must not stall on a full pipe */
+	g_unix_set_fd_nonblocking (stdin_fd, TRUE, NULL);
+	g_unix_set_fd_nonblocking (stdout_fd, TRUE, NULL);
+
+	io = g_slice_new0 (AppletVpnIo);
+	io->line_func = line_func;
+	io->done_func = done_func;
+	io->user_data = user_data;
+	io->cancellable = g_cancellable_new ();
+	io->data = g_bytes_ref (input);
+
+	io->output = g_unix_output_stream_new (stdin_fd, TRUE);
+	base = g_unix_input_stream_new (stdout_fd, TRUE);
+	io->input = g_data_input_stream_new (base);
+
+	if (timeout_sec)
+		io->timeout_id = g_timeout_add_seconds (timeout_sec, timeout_cb, io);
+
+	write_next (io);
+	read_next (io);
+	return io;
+}
+
+void
+applet_vpn_io_free (AppletVpnIo *io)
+{
+	if (!io)
+		return;
+
+	nm_clear_g_source (&io->timeout_id);
+	g_cancellable_cancel (io->cancellable);
+	g_clear_object (&io->cancellable);
+	g_clear_object (&io->output);
+	g_clear_object (&io->input);
+	g_bytes_unref (io->data);
+	g_slice_free (AppletVpnIo, io);
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef APPLET_VPN_IO_H
+#define APPLET_VPN_IO_H
+
+#include <gio/gio.h>
+
+typedef struct _AppletVpnIo AppletVpnIo;
+
+/* Called for each line of output, without the newline.  Returning FALSE
+ * stops the I/O and fails it with @error. */
+typedef gboolean (*AppletVpnIoLineFunc) (const char *line,
+                                         gsize len,
+                                         gpointer user_data,
+                                         GError **error);
+
+/* Called once, when the input has been written and the output read up to
+ * its end, or with @error when that failed or timed out.  The I/O may be
+ * freed from here. */
+typedef void (*AppletVpnIoDoneFunc) (GError *error,
+                                     gpointer user_data);
+
+AppletVpnIo *applet_vpn_io_new (int stdin_fd,
+                                int stdout_fd,
+                                GBytes *input,
+                                guint timeout_sec,
+                                AppletVpnIoLineFunc line_func,
+                                AppletVpnIoDoneFunc done_func,
+                                gpointer user_data);
+
+void         applet_vpn_io_free (AppletVpnIo *io);
+
+#endif  /* APPLET_VPN_IO_H */
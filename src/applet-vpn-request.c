@@ -20,6 +20,7 @@
 #include <errno.h>
 
 #include "nma-vpn-password-dialog.h"
+#include "applet-vpn-io.h"
 #include "nm-utils/nm-compat.h"
 #include "nm-utils/nm-shared-utils.h"
 
@@ -31,8 +32,15 @@ typedef struct {
 	char *value;
 	gboolean is_secret;
 	gboolean should_ask;
+	gboolean asked;
 } EuiSecret;
 
+typedef enum {
+	EUI_GROUP_NONE,
+	EUI_GROUP_HEADER,
+	EUI_GROUP_SECRET,
+} EuiGroup;
+
 typedef struct {
 	char *uuid;
 	char *id;
@@ -41,15 +49,32 @@ typedef struct {
 	guint watch_id;
 	GPid pid;
 
-	int child_stdout;
-	GString *child_response;
-	GIOChannel *channel;
-	guint channel_eventid;
+	AppletVpnIo *io;
+	gboolean io_done;
 	GVariantBuilder secrets_builder;
 	gboolean external_ui_mode;
 
-	/* These are just for the external UI mode */
-	EuiSecret *eui_secrets;
+	/* The secret whose value is on the next line, and whether the empty
+	 * line ending them has been seen */
+	char *secret_name;
+	gboolean secrets_done;
+
+	/* The auth dialog command line, for starting a warm helper once done */
+	char **warm_argv;
+
+	/* These are just for the external UI mode, where the response is
+	 * parsed as it arrives and the dialog shown as soon as there's
+	 * something to ask */
+	EuiGroup eui_group;
+	char *eui_version;
+	char *eui_title;
+	char *eui_description;
+	EuiSecret *eui_secret;
+	GPtrArray *eui_secrets;
+	EuiSecret *eui_asked[3];
+	guint eui_num_asked;
+	gboolean eui_answered;
+	gboolean eui_complete;
 	GtkDialog *dialog;
 } RequestData;
 
@@ -61,6 +86,7 @@ typedef struct {
 /*****************************************************************************/
 
 static void complete_request (VpnSecretsInfo *info);
+static gboolean external_ui_ask_pending (VpnSecretsInfo *info);
 
 /*****************************************************************************/
 
@@ -72,6 +98,17 @@ applet_vpn_request_get_secrets_size (void)
 
 /*****************************************************************************/
 
+static void
+eui_secret_free (gpointer data)
+{
+	EuiSecret *secret = data;
+
+	g_free (secret->name);
+	g_free (secret->label);
+	g_free (secret->value);
+	g_slice_free (EuiSecret, secret);
+}
+
 static void
 external_ui_add_secrets (VpnSecretsInfo *info)
 {
@@ -79,8 +116,8 @@ external_ui_add_secrets (VpnSecretsInfo *info)
 	EuiSecret *secret;
 	guint i;
 
-	for (i = 0; req_data->eui_secrets[i].name; i++) {
-		secret = &req_data->eui_secrets[i];
+	for (i = 0; i < req_data->eui_secrets->len; i++) {
+		secret = req_data->eui_secrets->pdata[i];
 		if (   secret->is_secret
 		    && secret->value
 		    && secret->value[0]) {
@@ -99,165 +136,332 @@ external_ui_dialog_response (GtkDialog *dialog, int response_id, gpointer user_d
 	NMAVpnPasswordDialog *vpn_dialog = NMA_VPN_PASSWORD_DIALOG (dialog);
 	EuiSecret *secret;
 	const char *value;
-	guint i_secret, i_pw;
+	guint i;
 
-	for (i_secret = 0, i_pw = 0; req_data->eui_secrets[i_secret].name; i_secret++) {
-		secret = &req_data->eui_secrets[i_secret];
-		if (   secret->is_secret
-		    && secret->should_ask) {
-			switch (i_pw) {
-			case 0:
-				value = nma_vpn_password_dialog_get_password (vpn_dialog);
-				break;
-			case 1:
-				value = nma_vpn_password_dialog_get_password_secondary (vpn_dialog);
-				break;
-			case 2:
-				value = nma_vpn_password_dialog_get_password_ternary (vpn_dialog);
-				break;
-			default:
-				continue;
-			}
-			g_free (secret->value);
-			secret->value = g_strdup (value);
-			i_pw++;
+	applet_secrets_request_stage_end (&info->req, APPLET_AGENT_STAGE_USER);
+
+	for (i = 0; i < req_data->eui_num_asked; i++) {
+		secret = req_data->eui_asked[i];
+		switch (i) {
+		case 0:
+			value = nma_vpn_password_dialog_get_password (vpn_dialog);
+			break;
+		case 1:
+			value = nma_vpn_password_dialog_get_password_secondary (vpn_dialog);
+			break;
+		default:
+			value = nma_vpn_password_dialog_get_password_ternary (vpn_dialog);
+			break;
 		}
+		g_free (secret->value);
+		secret->value = g_strdup (value);
 	}
 
 	gtk_widget_destroy (GTK_WIDGET (dialog));
 	g_clear_object (&req_data->dialog);
-	external_ui_add_secrets (info);
-	complete_request (info);
+	req_data->eui_answered = TRUE;
+
+	/* Otherwise the rest of the response is still to come */
+	if (req_data->eui_complete && !external_ui_ask_pending (info)) {
+		external_ui_add_secrets (info);
+		complete_request (info);
+	}
 }
 
+/* Adds a secret to the password dialog, showing the dialog if it's the
+ * first one.  Secrets that don't fit, or that arrive after the user
+ * answered the dialog, are left for external_ui_ask_pending(). */
+static void
+external_ui_ask (VpnSecretsInfo *info, EuiSecret *secret)
+{
+	RequestData *req_data = info->req_data;
+	NMAVpnPasswordDialog *dialog;
+	gboolean is_new = FALSE;
+
+	if (   req_data->eui_answered
+	    || req_data->eui_num_asked == G_N_ELEMENTS (req_data->eui_asked))
+		return;
+
+	if (!req_data->dialog) {
+		dialog = (NMAVpnPasswordDialog *) nma_vpn_password_dialog_new (req_data->eui_title,
+		                                                               req_data->eui_description,
+		                                                               NULL);
+		req_data->dialog = g_object_ref_sink (dialog);
+
+		nma_vpn_password_dialog_set_show_password (dialog, FALSE);
+		nma_vpn_password_dialog_set_show_password_secondary (dialog, FALSE);
+		nma_vpn_password_dialog_set_show_password_ternary (dialog, FALSE);
+		is_new = TRUE;
+	} else
+		dialog = NMA_VPN_PASSWORD_DIALOG (req_data->dialog);
+
+	switch (req_data->eui_num_asked) {
+	case 0:
+		nma_vpn_password_dialog_set_show_password (dialog, TRUE);
+		nma_vpn_password_dialog_set_password_label (dialog, secret->label);
+		if (secret->value)
+			nma_vpn_password_dialog_set_password (dialog, secret->value);
+		break;
+	case 1:
+		nma_vpn_password_dialog_set_show_password_secondary (dialog, TRUE);
+		nma_vpn_password_dialog_set_password_secondary_label (dialog, secret->label);
+		if (secret->value)
+			nma_vpn_password_dialog_set_password_secondary (dialog, secret->value);
+		break;
+	default:
+		nma_vpn_password_dialog_set_show_password_ternary (dialog, TRUE);
+		nma_vpn_password_dialog_set_password_ternary_label (dialog, secret->label);
+		if (secret->value)
+			nma_vpn_password_dialog_set_password_ternary (dialog, secret->value);
+		break;
+	}
+	req_data->eui_asked[req_data->eui_num_asked++] = secret;
+	secret->asked = TRUE;
+
+	if (is_new) {
+		g_signal_connect (dialog,
+		                  "response",
+		                  G_CALLBACK (external_ui_dialog_response),
+		                  info);
+		gtk_widget_show (GTK_WIDGET (dialog));
+		applet_secrets_request_stage_end (&info->req, APPLET_AGENT_STAGE_DIALOG_WAIT);
+		applet_secrets_request_stage_begin (&info->req, APPLET_AGENT_STAGE_USER);
+	}
+}
+
+/* Once the whole response is in, shows a follow-up dialog for the secrets
+ * the previous one didn't ask for.  Returns FALSE if there are none. */
 static gboolean
-external_ui_from_child_response (VpnSecretsInfo *info, GError **error)
+external_ui_ask_pending (VpnSecretsInfo *info)
 {
 	RequestData *req_data = info->req_data;
-	gs_unref_keyfile GKeyFile *keyfile = NULL;
-	gs_strfreev char **groups = NULL;
-	NMAVpnPasswordDialog *dialog = NULL;
-	gs_free char *version = NULL;
-	gs_free char *title = NULL;
-	gs_free char *message = NULL;
-	gsize num_groups;
-	guint num_ask = 0;
-	guint i_group, i_secret, i_pw;
-
-	/* Parse response key file */
-	keyfile = g_key_file_new ();
-
-	if (!g_key_file_load_from_data (keyfile,
-	                                req_data->child_response->str,
-	                                req_data->child_response->len,
-	                                G_KEY_FILE_NONE,
-	                                error)) {
-		return FALSE;
+	EuiSecret *secret;
+	guint i;
+
+	nm_assert (req_data->eui_complete);
+	nm_assert (!req_data->dialog);
+
+	req_data->eui_answered = FALSE;
+	req_data->eui_num_asked = 0;
+
+	for (i = 0; i < req_data->eui_secrets->len; i++) {
+		secret = req_data->eui_secrets->pdata[i];
+		if (secret->is_secret && secret->should_ask && !secret->asked)
+			external_ui_ask (info, secret);
 	}
 
-	groups = g_key_file_get_groups (keyfile, &num_groups);
-	if (g_strcmp0 (groups[0], "VPN Plugin UI") != 0) {
-		g_set_error_literal (error,
-		                     NM_SECRET_AGENT_ERROR,
-		                     NM_SECRET_AGENT_ERROR_FAILED,
-		                     "Expected [VPN Plugin UI]");
+	return req_data->dialog != NULL;
+}
+
+static gboolean
+external_ui_check_header (RequestData *req_data, GError **error)
+{
+	const char *missing = NULL;
+
+	if (g_strcmp0 (req_data->eui_version, "2") != 0)
+		missing = "Version=2";
+	else if (!req_data->eui_title)
+		missing = "Title";
+	else if (!req_data->eui_description)
+		missing = "Description";
+
+	if (missing) {
+		g_set_error (error,
+		             NM_SECRET_AGENT_ERROR,
+		             NM_SECRET_AGENT_ERROR_FAILED,
+		             "Expected %s", missing);
 		return FALSE;
 	}
+	return TRUE;
+}
 
-	version = g_key_file_get_string (keyfile, "VPN Plugin UI", "Version", error);
-	if (!version)
-		return FALSE;
-	if (strcmp (version, "2") != 0) {
-		g_set_error_literal (error,
-		                     NM_SECRET_AGENT_ERROR,
-		                     NM_SECRET_AGENT_ERROR_FAILED,
-		                     "Expected Version=2");
-		return FALSE;
+/* Done with the group of a secret */
+static void
+external_ui_group_end (VpnSecretsInfo *info)
+{
+	RequestData *req_data = info->req_data;
+	EuiSecret *secret = g_steal_pointer (&req_data->eui_secret);
+
+	if (!secret)
+		return;
+
+	if (!secret->label) {
+		g_warning ("Skipping entry: no label\n");
+		eui_secret_free (secret);
+		return;
 	}
 
-	title = g_key_file_get_string (keyfile, "VPN Plugin UI", "Title", error);
-	if (!title)
-		return FALSE;
+	g_ptr_array_add (req_data->eui_secrets, secret);
+	if (secret->is_secret && secret->should_ask)
+		external_ui_ask (info, secret);
+}
 
-	message = g_key_file_get_string (keyfile, "VPN Plugin UI", "Description", error);
-	if (!message)
-		return FALSE;
+/* Values are unescaped the way GKeyFile does */
+static char *
+external_ui_unescape (const char *value)
+{
+	char *result = g_malloc (strlen (value) + 1);
+	char *r = result;
 
-	/* Create a secret instance for each group */
-	req_data->eui_secrets = g_new0 (EuiSecret, num_groups);
-	for (i_group = 1, i_secret = 0; i_group < num_groups; i_group++) {
-		EuiSecret *secret = &req_data->eui_secrets[i_secret];
-		const char *group = groups[i_group];
-		char *label;
+	while (g_ascii_isspace (*value))
+		value++;
 
-		label = g_key_file_get_string (keyfile, group, "Label", NULL);
-		if (!label) {
-			g_warning ("Skipping entry: no label\n");
+	for (; *value; value++) {
+		if (value[0] != '\\' || !value[1]) {
+			*r++ = *value;
 			continue;
 		}
+		switch (*++value) {
+		case 's':
+			*r++ = ' ';
+			break;
+		case 'n':
+			*r++ = '\n';
+			break;
+		case 't':
+			*r++ = '\t';
+			break;
+		case 'r':
+			*r++ = '\r';
+			break;
+		case '\\':
+			*r++ = '\\';
+			break;
+		default:
+			*r++ = '\\';
+			*r++ = *value;
+			break;
+		}
+	}
+	*r = '\0';
+	return result;
+}
+
+static gboolean
+external_ui_parse_bool (char *value)
+{
+	g_strchomp (value);
+	return nm_streq (value, "true") || nm_streq (value, "1");
+}
+
+/* Parses the "[VPN Plugin UI]" response a line at a time: a header group
+ * with the Version, Title and Description, followed by a group for each
+ * secret. */
+static gboolean
+external_ui_parse_line (VpnSecretsInfo *info, const char *line, GError **error)
+{
+	RequestData *req_data = info->req_data;
+	gs_free char *group = NULL;
+	gs_free char *key = NULL;
+	char *value, **target = NULL;
+	const char *eq, *end;
+
+	while (g_ascii_isspace (*line))
+		line++;
+	if (!line[0] || line[0] == '#')
+		return TRUE;
+
+	if (line[0] == '[') {
+		end = strrchr (line, ']');
+		if (!end)
+			goto invalid;
+		group = g_strndup (line + 1, end - line - 1);
+
+		if (req_data->eui_group == EUI_GROUP_NONE) {
+			if (!nm_streq (group, "VPN Plugin UI"))
+				goto no_header;
+			req_data->eui_group = EUI_GROUP_HEADER;
+			return TRUE;
+		}
 
-		secret->name = g_strdup (group);
-		secret->label = label;
-		secret->value = g_key_file_get_string (keyfile, group, "Value", NULL);
-		secret->is_secret = g_key_file_get_boolean (keyfile, group, "IsSecret", NULL);
-		secret->should_ask = g_key_file_get_boolean (keyfile, group, "ShouldAsk", NULL);
+		if (   req_data->eui_group == EUI_GROUP_HEADER
+		    && !external_ui_check_header (req_data, error))
+			return FALSE;
 
-		i_secret++;
+		external_ui_group_end (info);
+		req_data->eui_group = EUI_GROUP_SECRET;
+		req_data->eui_secret = g_slice_new0 (EuiSecret);
+		req_data->eui_secret->name = g_steal_pointer (&group);
+		return TRUE;
+	}
 
-		if (secret->is_secret && secret->should_ask)
-			num_ask++;
+	if (req_data->eui_group == EUI_GROUP_NONE)
+		goto no_header;
+
+	eq = strchr (line, '=');
+	if (!eq)
+		goto invalid;
+	key = g_strchomp (g_strndup (line, eq - line));
+	value = external_ui_unescape (eq + 1);
+
+	if (req_data->eui_group == EUI_GROUP_HEADER) {
+		if (nm_streq (key, "Version"))
+			target = &req_data->eui_version;
+		else if (nm_streq (key, "Title"))
+			target = &req_data->eui_title;
+		else if (nm_streq (key, "Description"))
+			target = &req_data->eui_description;
+	} else {
+		EuiSecret *secret = req_data->eui_secret;
+
+		if (nm_streq (key, "Label"))
+			target = &secret->label;
+		else if (nm_streq (key, "Value"))
+			target = &secret->value;
+		else if (nm_streq (key, "IsSecret"))
+			secret->is_secret = external_ui_parse_bool (value);
+		else if (nm_streq (key, "ShouldAsk"))
+			secret->should_ask = external_ui_parse_bool (value);
 	}
 
-	/* If there are any secrets that must be asked to user,
-	 * create a dialog and display it. */
-	if (num_ask > 0) {
-		dialog = (NMAVpnPasswordDialog *) nma_vpn_password_dialog_new (title, message, NULL);
-		req_data->dialog = g_object_ref_sink (dialog);
+	if (target) {
+		g_free (*target);
+		*target = value;
+	} else
+		g_free (value);
+	return TRUE;
 
-		nma_vpn_password_dialog_set_show_password (dialog, FALSE);
-		nma_vpn_password_dialog_set_show_password_secondary (dialog, FALSE);
-		nma_vpn_password_dialog_set_show_password_ternary (dialog, FALSE);
+no_header:
+	g_set_error_literal (error,
+	                     NM_SECRET_AGENT_ERROR,
+	                     NM_SECRET_AGENT_ERROR_FAILED,
+	                     "Expected [VPN Plugin UI]");
+	return FALSE;
 
-		for (i_secret = 0, i_pw = 0; req_data->eui_secrets[i_secret].name; i_secret++) {
-			EuiSecret *secret = &req_data->eui_secrets[i_secret];
-
-			if (   secret->is_secret
-			    && secret->should_ask) {
-				switch (i_pw) {
-				case 0:
-					nma_vpn_password_dialog_set_show_password (dialog, TRUE);
-					nma_vpn_password_dialog_set_password_label (dialog, secret->label);
-					if (secret->value)
-						nma_vpn_password_dialog_set_password (dialog, secret->value);
-					break;
-				case 1:
-					nma_vpn_password_dialog_set_show_password_secondary (dialog, TRUE);
-					nma_vpn_password_dialog_set_password_secondary_label (dialog, secret->label);
-					if (secret->value)
-						nma_vpn_password_dialog_set_password_secondary (dialog, secret->value);
-					break;
-				case 2:
-					nma_vpn_password_dialog_set_show_password_ternary (dialog, TRUE);
-					nma_vpn_password_dialog_set_password_ternary_label (dialog, secret->label);
-					if (secret->value)
-						nma_vpn_password_dialog_set_password_ternary (dialog, secret->value);
-					break;
-				default:
-					g_warning ("Skipping entry: more than 3 passwords not supported\n");
-					continue;
-				}
-				i_pw++;
-			}
-		}
-		g_signal_connect (dialog,
-		                  "response",
-		                  G_CALLBACK (external_ui_dialog_response),
-		                  info);
-		gtk_widget_show (GTK_WIDGET (dialog));
-		return TRUE;
+invalid:
+	g_set_error (error,
+	             NM_SECRET_AGENT_ERROR,
+	             NM_SECRET_AGENT_ERROR_FAILED,
+	             "Invalid line in the VPN plugin UI response: '%s'", line);
+	return FALSE;
+}
+
+/* The whole response has been read */
+static gboolean
+external_ui_finish (VpnSecretsInfo *info, GError **error)
+{
+	RequestData *req_data = info->req_data;
+
+	if (req_data->eui_group == EUI_GROUP_NONE) {
+		g_set_error_literal (error,
+		                     NM_SECRET_AGENT_ERROR,
+		                     NM_SECRET_AGENT_ERROR_FAILED,
+		                     "Expected [VPN Plugin UI]");
+		return FALSE;
 	}
 
-	/* Nothing to ask, return known secrets */
+	if (   req_data->eui_group == EUI_GROUP_HEADER
+	    && !external_ui_check_header (req_data, error))
+		return FALSE;
+
+	external_ui_group_end (info);
+	req_data->eui_complete = TRUE;
+
+	/* Wait for the user to answer */
+	if (req_data->dialog || external_ui_ask_pending (info))
+		return TRUE;
+
+	/* Nothing to ask, or all answered; return known secrets */
 	external_ui_add_secrets (info);
 	complete_request (info);
 	return TRUE;
@@ -296,23 +500,12 @@ process_child_response (VpnSecretsInfo *info)
 	gs_free_error GError *error = NULL;
 
 	if (req_data->external_ui_mode) {
-		if (!external_ui_from_child_response (info, &error)) {
+		if (!external_ui_finish (info, &error)) {
 			applet_secrets_request_complete (req, NULL, error);
 			applet_secrets_request_free (req);
 		}
-	} else {
-		char **lines = g_strsplit (req_data->child_response->str, "\n", -1);
-		int i;
-
-		for (i = 0; lines[i] && *(lines[i]); i += 2) {
-			if (lines[i + 1] == NULL)
-				break;
-			g_variant_builder_add (&req_data->secrets_builder, "{ss}", lines[i], lines[i + 1]);
-		}
-
-		g_strfreev (lines);
+	} else
 		complete_request (info);
-	}
 }
 
 static void
@@ -333,47 +526,56 @@ child_finished_cb (GPid pid, int status, gpointer user_data)
 
 		applet_secrets_request_complete (req, NULL, error);
 		applet_secrets_request_free (req);
-	} else if (req_data->channel_eventid == 0) {
+	} else if (req_data->io_done) {
 		/* We now have both the child response and its exit status. Process it. */
 		process_child_response (info);
 	}
 }
 
 static gboolean
-child_stdout_data_cb (GIOChannel *source, GIOCondition condition, gpointer user_data)
+child_line_cb (const char *line, gsize len, gpointer user_data, GError **error)
 {
-	SecretsRequest *req = user_data;
-	VpnSecretsInfo *info = (VpnSecretsInfo *) req;
+	VpnSecretsInfo *info = user_data;
 	RequestData *req_data = info->req_data;
-	GIOStatus status;
-	char buf[4096];
-	size_t bytes_read;
-	gs_free_error GError *error = NULL;
 
-	status = g_io_channel_read_chars (source, buf, sizeof (buf)-1, &bytes_read, &error);
-	switch (status) {
-	case G_IO_STATUS_ERROR:
-		req_data->channel_eventid = 0;
+	if (req_data->external_ui_mode)
+		return external_ui_parse_line (info, line, error);
+
+	/* Alternating secret name and value lines, up to an empty line */
+	if (req_data->secrets_done)
+		return TRUE;
+
+	if (req_data->secret_name) {
+		g_variant_builder_add (&req_data->secrets_builder, "{ss}", req_data->secret_name, line);
+		nm_clear_g_free (&req_data->secret_name);
+	} else if (line[0])
+		req_data->secret_name = g_strndup (line, len);
+	else
+		req_data->secrets_done = TRUE;
+
+	return TRUE;
+}
+
+static void
+child_io_done_cb (GError *error, gpointer user_data)
+{
+	VpnSecretsInfo *info = user_data;
+	SecretsRequest *req = (SecretsRequest *) info;
+	RequestData *req_data = info->req_data;
+
+	if (error) {
 		applet_secrets_request_complete (req, NULL, error);
 		applet_secrets_request_free (req);
-		return FALSE;
-	case G_IO_STATUS_EOF:
-		req_data->channel_eventid = 0;
-		if (req_data->pid == 0) {
-			/* We now have both the childe respons and
-			 * its exit status. Process it. */
-			process_child_response (info);
-		}
-		return FALSE;
-	case G_IO_STATUS_NORMAL:
-		g_string_append_len (req_data->child_response, buf, bytes_read);
-		break;
-	default:
-		/* What just happened... */
-		g_return_val_if_reached (FALSE);
+		return;
 	}
 
-	return TRUE;
+	req_data->io_done = TRUE;
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_AUTH_DIALOG);
+	if (req_data->pid == 0) {
+		/* We now have both the child response and
+		 * its exit status. Process it. */
+		process_child_response (info);
+	}
 }
 
 /*****************************************************************************/
@@ -407,9 +609,8 @@ _str_append (GString *str,
 	g_string_append_c (str, '\n');
 }
 
-static char *
+static GBytes *
 connection_to_data (NMConnection *connection,
-                    gsize *out_length,
                     GError **error)
 {
 	NMSettingVpn *s_vpn;
@@ -445,60 +646,252 @@ connection_to_data (NMConnection *connection,
 	nm_clear_g_free (&keys);
 
 	g_string_append (buf, "DONE\n\nQUIT\n\n");
-	NM_SET_OUT (out_length, buf->len);
-	return g_string_free (buf, FALSE);
+	return g_string_free_to_bytes (buf);
+}
+
+/*****************************************************************************/
+
+static void
+vpn_child_setup (gpointer user_data)
+{
+	/* We are in the child process at this point */
+	pid_t pid = getpid ();
+	setpgid (pid, pid);
+}
+
+static const char **
+auth_dialog_envp (void)
+{
+	const char **envp;
+	gsize environ_len;
+	gsize i, j;
+
+	environ_len = NM_PTRARRAY_LEN (environ);
+	envp = g_new (const char *, environ_len + 1);
+	for (i = 0, j = 0; i < environ_len; i++) {
+		const char *e = environ[i];
+
+		if (g_str_has_prefix (e, "G_MESSAGES_DEBUG=")) {
+			/* skip this environment variable. We interact with the auth-dialog via stdout.
+			 * G_MESSAGES_DEBUG may enable additional debugging messages from GTK. */
+			continue;
+		}
+		envp[j++] = e;
+	}
+	envp[j] = NULL;
+	return envp;
+}
+
+static gboolean
+ensure_killed (gpointer data)
+{
+	pid_t pid = GPOINTER_TO_INT (data);
+
+	kill (pid, SIGKILL);
+	waitpid (pid, NULL, 0);
+	return FALSE;
+}
+
+static void
+auth_dialog_kill (GPid pid)
+{
+	if (kill (pid, SIGTERM) == 0)
+		g_timeout_add_seconds (2, ensure_killed, GINT_TO_POINTER (pid));
+	else {
+		kill (pid, SIGKILL);
+		waitpid (pid, NULL, 0);
+	}
 }
 
 /*****************************************************************************/
 
+/* Some auth dialogs take long enough to start (mostly initializing GTK) for
+ * it to show as VPN connect latency, and they only read the connection from
+ * stdin after that.  For the service types listed in the
+ * "vpn-warm-auth-dialogs" setting, once a request is done another helper is
+ * started with the same command line and left waiting on stdin, to serve
+ * the next request for the connection, which usually is a reconnect.
+ */
+
+#define WARM_HELPERS_MAX         4
+#define WARM_HELPER_TIMEOUT_SEC  600
+
+typedef struct {
+	char *service_type;
+	char **argv;
+	GPid pid;
+	int child_stdin;
+	int child_stdout;
+	guint watch_id;
+	guint timeout_id;
+} WarmHelper;
+
+static GHashTable *warm_helpers;  /* service type -> WarmHelper */
+static char **warm_types;
+
+static void
+warm_helper_free (gpointer data)
+{
+	WarmHelper *helper = data;
+
+	nm_clear_g_source (&helper->watch_id);
+	nm_clear_g_source (&helper->timeout_id);
+	if (helper->pid)
+		auth_dialog_kill (helper->pid);
+	if (helper->child_stdin >= 0)
+		close (helper->child_stdin);
+	if (helper->child_stdout >= 0)
+		close (helper->child_stdout);
+	g_strfreev (helper->argv);
+	g_free (helper->service_type);
+	g_slice_free (WarmHelper, helper);
+}
+
+static void
+warm_helper_exited_cb (GPid pid, int status, gpointer user_data)
+{
+	WarmHelper *helper = user_data;
+
+	helper->watch_id = 0;
+	helper->pid = 0;
+	g_debug ("Warm VPN auth dialog for '%s' exited early", helper->service_type);
+	g_hash_table_remove (warm_helpers, helper->service_type);
+}
+
 static gboolean
-connection_to_fd (NMConnection *connection,
-                  int fd,
-                  GError **error)
+warm_helper_timeout_cb (gpointer user_data)
 {
-	gs_free char *data = NULL;
-	gsize data_len;
-	gssize w;
-	int errsv;
+	WarmHelper *helper = user_data;
 
-	data = connection_to_data (connection, &data_len, error);
-	if (!data)
+	helper->timeout_id = 0;
+	g_hash_table_remove (warm_helpers, helper->service_type);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+argv_equal (const char *const*a, const char *const*b)
+{
+	for (; *a && *b; a++, b++) {
+		if (strcmp (*a, *b))
+			return FALSE;
+	}
+	return !*a && !*b;
+}
+
+static gboolean
+warm_helper_take (const char *service_type,
+                  const char *const*argv,
+                  GPid *out_pid,
+                  int *out_stdin,
+                  int *out_stdout)
+{
+	WarmHelper *helper;
+
+	if (!warm_helpers)
 		return FALSE;
 
-again:
-	w = write (fd, data, data_len);
-	if (w < 0) {
-		errsv = errno;
-		if (errsv == EINTR)
-			goto again;
-		g_set_error (error,
-		             NM_SECRET_AGENT_ERROR,
-		             NM_SECRET_AGENT_ERROR_FAILED,
-		             _("Failed to write connection to VPN UI: %s (%d)"), g_strerror (errsv), errsv);
+	helper = g_hash_table_lookup (warm_helpers, service_type);
+	if (!helper)
 		return FALSE;
-	}
 
-	if ((gsize) w != data_len) {
-		g_set_error_literal (error,
-		                     NM_SECRET_AGENT_ERROR,
-		                     NM_SECRET_AGENT_ERROR_FAILED,
-		                     _("Failed to write connection to VPN UI: incomplete write"));
+	if (!argv_equal ((const char *const*) helper->argv, argv)) {
+		/* It was started for another connection, or other flags or hints */
+		g_hash_table_remove (warm_helpers, service_type);
 		return FALSE;
 	}
 
+	g_hash_table_steal (warm_helpers, service_type);
+
+	/* The request watches the child from now on */
+	nm_clear_g_source (&helper->watch_id);
+	*out_pid = helper->pid;
+	*out_stdin = helper->child_stdin;
+	*out_stdout = helper->child_stdout;
+	helper->pid = 0;
+	helper->child_stdin = -1;
+	helper->child_stdout = -1;
+	warm_helper_free (helper);
 	return TRUE;
 }
 
-/*****************************************************************************/
-
 static void
-vpn_child_setup (gpointer user_data)
+warm_helper_start (const char *service_type, char **argv)
 {
-	/* We are in the child process at this point */
-	pid_t pid = getpid ();
-	setpgid (pid, pid);
+	gs_free const char **envp = NULL;
+	gs_free_error GError *error = NULL;
+	WarmHelper *helper;
+
+	/* No longer wanted, e.g. while shutting down */
+	if (!warm_types || !g_strv_contains ((const char *const*) warm_types, service_type))
+		return;
+
+	if (!warm_helpers)
+		warm_helpers = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, warm_helper_free);
+
+	helper = g_hash_table_lookup (warm_helpers, service_type);
+	if (helper) {
+		if (argv_equal ((const char *const*) helper->argv, (const char *const*) argv))
+			return;
+		g_hash_table_remove (warm_helpers, service_type);
+	}
+
+	if (g_hash_table_size (warm_helpers) >= WARM_HELPERS_MAX)
+		return;
+
+	helper = g_slice_new0 (WarmHelper);
+	envp = auth_dialog_envp ();
+	if (!g_spawn_async_with_pipes (NULL,
+	                               argv,
+	                               (char **) envp,
+	                               G_SPAWN_DO_NOT_REAP_CHILD,
+	                               vpn_child_setup,
+	                               NULL,
+	                               &helper->pid,
+	                               &helper->child_stdin,
+	                               &helper->child_stdout,
+	                               NULL,
+	                               &error)) {
+		g_debug ("Could not start a warm VPN auth dialog for '%s': %s",
+		         service_type, error->message);
+		g_slice_free (WarmHelper, helper);
+		return;
+	}
+
+	helper->service_type = g_strdup (service_type);
+	helper->argv = g_strdupv (argv);
+	helper->watch_id = g_child_watch_add (helper->pid, warm_helper_exited_cb, helper);
+	helper->timeout_id = g_timeout_add_seconds (WARM_HELPER_TIMEOUT_SEC, warm_helper_timeout_cb, helper);
+	g_hash_table_insert (warm_helpers, helper->service_type, helper);
+}
+
+/**
+ * applet_vpn_request_set_warm_auth_dialogs:
+ * @service_types: (allow-none): the VPN service types to keep an auth dialog
+ *   started for
+ *
+ * Idle helpers of service types not in @service_types are stopped.
+ */
+void
+applet_vpn_request_set_warm_auth_dialogs (const char *const*service_types)
+{
+	GHashTableIter iter;
+	WarmHelper *helper;
+
+	g_strfreev (warm_types);
+	warm_types = service_types && service_types[0] ? g_strdupv ((char **) service_types) : NULL;
+
+	if (!warm_helpers)
+		return;
+
+	g_hash_table_iter_init (&iter, warm_helpers);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &helper)) {
+		if (!warm_types || !g_strv_contains ((const char *const*) warm_types, helper->service_type))
+			g_hash_table_iter_remove (&iter);
+	}
 }
 
+/*****************************************************************************/
+
 static gboolean
 auth_dialog_spawn (const char *con_id,
                    const char *con_uuid,
@@ -511,13 +904,13 @@ auth_dialog_spawn (const char *con_id,
                    GPid *out_pid,
                    int *out_stdin,
                    int *out_stdout,
+                   char ***out_warm_argv,
                    GError **error)
 {
 	gsize hints_len;
 	gsize i, j;
 	gs_free const char **argv = NULL;
 	gs_free const char **envp = NULL;
-	gsize environ_len;
 
 	g_return_val_if_fail (con_id, FALSE);
 	g_return_val_if_fail (con_uuid, FALSE);
@@ -550,49 +943,32 @@ auth_dialog_spawn (const char *con_id,
 	nm_assert (i <= 10 + (2 * hints_len));
 	argv[i++] = NULL;
 
-	environ_len = NM_PTRARRAY_LEN (environ);
-	envp = g_new (const char *, environ_len + 1);
-	memcpy (envp, environ, sizeof (const char *) * environ_len);
-	for (i = 0, j = 0; i < environ_len; i++) {
-		const char *e = environ[i];
-
-		if (g_str_has_prefix (e, "G_MESSAGES_DEBUG=")) {
-			/* skip this environment variable. We interact with the auth-dialog via stdout.
-			 * G_MESSAGES_DEBUG may enable additional debugging messages from GTK. */
-			continue;
-		}
-		envp[j++] = e;
+	if (warm_helper_take (service_type, argv, out_pid, out_stdin, out_stdout))
+		g_debug ("Using the warm VPN auth dialog for '%s'", service_type);
+	else {
+		envp = auth_dialog_envp ();
+		if (!g_spawn_async_with_pipes (NULL,
+		                               (char **) argv,
+		                               (char **) envp,
+		                               G_SPAWN_DO_NOT_REAP_CHILD,
+		                               vpn_child_setup,
+		                               NULL,
+		                               out_pid,
+		                               out_stdin,
+		                               out_stdout,
+		                               NULL,
+		                               error))
+			return FALSE;
 	}
-	envp[j] = NULL;
 
-	if (!g_spawn_async_with_pipes (NULL,
-	                               (char **) argv,
-	                               (char **) envp,
-	                               G_SPAWN_DO_NOT_REAP_CHILD,
-	                               vpn_child_setup,
-	                               NULL,
-	                               out_pid,
-	                               out_stdin,
-	                               out_stdout,
-	                               NULL,
-	                               error))
-		return FALSE;
+	if (warm_types && g_strv_contains ((const char *const*) warm_types, service_type))
+		*out_warm_argv = g_strdupv ((char **) argv);
 
 	return TRUE;
 }
 
 /*****************************************************************************/
 
-static gboolean
-ensure_killed (gpointer data)
-{
-	pid_t pid = GPOINTER_TO_INT (data);
-
-	kill (pid, SIGKILL);
-	waitpid (pid, NULL, 0);
-	return FALSE;
-}
-
 static void
 dialog_response_destroy (GtkDialog *dialog, int response_id, gpointer user_data)
 {
@@ -605,45 +981,39 @@ free_vpn_secrets_info (SecretsRequest *req)
 {
 
 	RequestData *req_data;
-	guint i;
 
 	req_data = ((VpnSecretsInfo *) req)->req_data;
 
 	if (!req_data)
 		return;
 
-	g_free (req_data->uuid);
-	g_free (req_data->id);
-	g_free (req_data->service_type);
-
 	nm_clear_g_source (&req_data->watch_id);
 
-	nm_clear_g_source (&req_data->channel_eventid);
-	if (req_data->channel)
-		g_io_channel_unref (req_data->channel);
+	g_clear_pointer (&req_data->io, applet_vpn_io_free);
 
-	if (req_data->pid) {
-		if (kill (req_data->pid, SIGTERM) == 0)
-			g_timeout_add_seconds (2, ensure_killed, GINT_TO_POINTER (req_data->pid));
-		else {
-			kill (req_data->pid, SIGKILL);
-			waitpid (req_data->pid, NULL, 0);
-		}
+	if (req_data->pid)
+		auth_dialog_kill (req_data->pid);
+
+	if (req_data->warm_argv) {
+		warm_helper_start (req_data->service_type, req_data->warm_argv);
+		g_strfreev (req_data->warm_argv);
 	}
 
-	if (req_data->child_response)
-		g_string_free (req_data->child_response, TRUE);
+	g_free (req_data->uuid);
+	g_free (req_data->id);
+	g_free (req_data->service_type);
+
+	g_free (req_data->secret_name);
 
 	g_variant_builder_clear (&req_data->secrets_builder);
 
-	if (req_data->eui_secrets) {
-		for (i = 0; req_data->eui_secrets[i].name; i++) {
-			g_free (req_data->eui_secrets[i].name);
-			g_free (req_data->eui_secrets[i].label);
-			g_free (req_data->eui_secrets[i].value);
-		}
-		g_free (req_data->eui_secrets);
-	}
+	g_free (req_data->eui_version);
+	g_free (req_data->eui_title);
+	g_free (req_data->eui_description);
+	if (req_data->eui_secret)
+		eui_secret_free (req_data->eui_secret);
+	if (req_data->eui_secrets)
+		g_ptr_array_unref (req_data->eui_secrets);
 
 	if (req_data->dialog) {
 		g_signal_handlers_disconnect_by_func (req_data->dialog,
@@ -659,6 +1029,96 @@ free_vpn_secrets_info (SecretsRequest *req)
 	g_slice_free (RequestData, req_data);
 }
 
+static guint auth_dialog_timeout;
+
+/**
+ * applet_vpn_request_set_timeout:
+ * @timeout_sec: how long an auth dialog may take to return the secrets,
+ *   0 for no limit
+ */
+void
+applet_vpn_request_set_timeout (guint timeout_sec)
+{
+	auth_dialog_timeout = timeout_sec;
+}
+
+/*****************************************************************************/
+
+/* Looking up the plugin of a service type reads and parses all the .name
+ * files, so remember what was found until the plugin directories change.
+ * Failed lookups are not remembered, as a newly installed plugin could be in
+ * a directory that isn't watched yet.
+ */
+static GHashTable *plugin_cache;     /* service type -> NMVpnPluginInfo */
+static GHashTable *plugin_monitors;  /* directory -> GFileMonitor, or NULL */
+
+static void
+plugin_dir_changed_cb (GFileMonitor *monitor,
+                       GFile *file,
+                       GFile *other_file,
+                       GFileMonitorEvent event_type,
+                       gpointer user_data)
+{
+	g_hash_table_remove_all (plugin_cache);
+}
+
+static gboolean
+plugin_dir_watch (const char *dirname)
+{
+	gs_unref_object GFile *dir = NULL;
+	GFileMonitor *monitor;
+
+	if (g_hash_table_lookup_extended (plugin_monitors, dirname, NULL, (gpointer) &monitor))
+		return !!monitor;
+
+	dir = g_file_new_for_path (dirname);
+	monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, NULL);
+	if (monitor)
+		g_signal_connect (monitor, "changed", G_CALLBACK (plugin_dir_changed_cb), NULL);
+	else
+		g_debug ("Can't watch '%s', not caching the VPN plugins found there", dirname);
+
+	g_hash_table_insert (plugin_monitors, g_strdup (dirname), monitor);
+	return !!monitor;
+}
+
+static NMVpnPluginInfo *
+plugin_info_lookup (const char *service_type)
+{
+	NMVpnPluginInfo *plugin;
+	gs_free char *dirname = NULL;
+	const char *filename;
+
+	if (G_UNLIKELY (!plugin_cache)) {
+		plugin_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+		plugin_monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, nm_g_object_unref);
+
+		/* The .name files there take precedence over the ones in the
+		 * library directory, so a plugin appearing there must invalidate
+		 * the cache even if none of the cached plugins came from there. */
+		plugin_dir_watch ("/etc/NetworkManager/VPN");
+		if (g_getenv ("NM_VPN_PLUGIN_USER_DIR"))
+			plugin_dir_watch (g_getenv ("NM_VPN_PLUGIN_USER_DIR"));
+	}
+
+	plugin = g_hash_table_lookup (plugin_cache, service_type);
+	if (plugin)
+		return g_object_ref (plugin);
+
+	plugin = nm_vpn_plugin_info_new_search_file (NULL, service_type);
+	if (!plugin)
+		return NULL;
+
+	filename = nm_vpn_plugin_info_get_filename (plugin);
+	if (filename) {
+		dirname = g_path_get_dirname (filename);
+		if (plugin_dir_watch (dirname))
+			g_hash_table_insert (plugin_cache, g_strdup (service_type), g_object_ref (plugin));
+	}
+
+	return plugin;
+}
+
 gboolean
 applet_vpn_request_get_secrets (SecretsRequest *req, GError **error)
 {
@@ -670,7 +1130,9 @@ applet_vpn_request_get_secrets (SecretsRequest *req, GError **error)
 	const char *service_type;
 	const char *auth_dialog;
 	gs_unref_object NMVpnPluginInfo *plugin = NULL;
+	gs_unref_bytes GBytes *data = NULL;
 	int child_stdin;
+	int child_stdout;
 
 	applet_secrets_request_set_free_func (req, free_vpn_secrets_info);
 
@@ -683,7 +1145,7 @@ applet_vpn_request_get_secrets (SecretsRequest *req, GError **error)
 	service_type = nm_setting_vpn_get_service_type (s_vpn);
 	g_return_val_if_fail (service_type, FALSE);
 
-	plugin = nm_vpn_plugin_info_new_search_file (NULL, service_type);
+	plugin = plugin_info_lookup (service_type);
 	auth_dialog = plugin ? nm_vpn_plugin_info_get_auth_dialog (plugin) : NULL;
 	if (!auth_dialog) {
 		g_set_error (error,
@@ -694,6 +1156,10 @@ applet_vpn_request_get_secrets (SecretsRequest *req, GError **error)
 		return FALSE;
 	}
 
+	data = connection_to_data (req->connection, error);
+	if (!data)
+		return FALSE;
+
 	info->req_data = g_slice_new0 (RequestData);
 	if (!info->req_data) {
 		g_set_error_literal (error,
@@ -703,6 +1169,7 @@ applet_vpn_request_get_secrets (SecretsRequest *req, GError **error)
 		return FALSE;
 	}
 	req_data = info->req_data;
+	req_data->service_type = g_strdup (service_type);
 
 	g_variant_builder_init (&req_data->secrets_builder, G_VARIANT_TYPE ("a{ss}"));
 
@@ -722,27 +1189,25 @@ applet_vpn_request_get_secrets (SecretsRequest *req, GError **error)
 	                        req->flags,
 	                        &req_data->pid,
 	                        &child_stdin,
-	                        &req_data->child_stdout,
+	                        &child_stdout,
+	                        &req_data->warm_argv,
 	                        error))
 		return FALSE;
+	applet_secrets_request_stage_begin (req, APPLET_AGENT_STAGE_AUTH_DIALOG);
 
 	/* catch when child is reaped */
 	req_data->watch_id = g_child_watch_add (req_data->pid, child_finished_cb, info);
 
-	/* listen to what child has to say */
-	req_data->channel = g_io_channel_unix_new (req_data->child_stdout);
-	req_data->child_response = g_string_sized_new (4096);
-	req_data->channel_eventid = g_io_add_watch (req_data->channel,
-	                                            G_IO_IN  | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
-	                                            child_stdout_data_cb,
-	                                            info);
-
-	if (!connection_to_fd (req->connection, child_stdin, error))
-		return FALSE;
-	close (child_stdin);
-
-	g_io_channel_set_encoding (req_data->channel, NULL, NULL);
-
-	/* Dump parts of the connection to the child */
+	/* Dump parts of the connection to the child and listen to what it
+	 * has to say */
+	if (req_data->external_ui_mode)
+		req_data->eui_secrets = g_ptr_array_new_with_free_func (eui_secret_free);
+	req_data->io = applet_vpn_io_new (child_stdin,
+	                                  child_stdout,
+	                                  data,
+	                                  auth_dialog_timeout,
+	                                  child_line_cb,
+	                                  child_io_done_cb,
+	                                  info);
 	return TRUE;
 }
@@ -15,5 +15,9 @@ size_t applet_vpn_request_get_secrets_size (void);
 
 gboolean applet_vpn_request_get_secrets (SecretsRequest *req, GError **error);
 
+void applet_vpn_request_set_warm_auth_dialogs (const char *const*service_types);
+
+void applet_vpn_request_set_timeout (guint timeout_sec);
+
 #endif  /* APPLET_VPN_REQUEST_H */
 
@@ -26,9 +26,12 @@
 #include "applet-device-bt.h"
 #include "applet-device-ethernet.h"
 #include "applet-device-wifi.h"
+#include "applet-debug.h"
+#include "applet-record.h"
 #include "applet-dialogs.h"
 #include "nma-wifi-dialog.h"
 #include "applet-vpn-request.h"
+#include "applet-trace.h"
 #include "utils.h"
 
 #if WITH_WWAN
@@ -52,6 +55,9 @@ applet_request_wifi_scan (NMApplet *applet)
 	NMDevice *device;
 	int i;
 
+	if (!applet->nm_client)
+		return G_SOURCE_CONTINUE;
+
 	g_debug ("requesting wifi scan");
 
 	/* Request scan for all wifi devices */
@@ -121,6 +127,18 @@ applet_workaround_show_cb (NMApplet *applet, gpointer unused)
 }
 #endif
 
+static NMADeviceClass *
+ensure_device_class (NMADeviceClass **dclass,
+                     NMADeviceClass *(*get_class) (NMApplet *applet),
+                     NMApplet *applet)
+{
+	if (!*dclass) {
+		*dclass = get_class (applet);
+		g_assert (*dclass);
+	}
+	return *dclass;
+}
+
 static inline NMADeviceClass *
 get_device_class (NMDevice *device, NMApplet *applet)
 {
@@ -128,17 +146,17 @@ get_device_class (NMDevice *device, NMApplet *applet)
 	g_return_val_if_fail (applet != NULL, NULL);
 
 	if (NM_IS_DEVICE_ETHERNET (device))
-		return applet->ethernet_class;
+		return ensure_device_class (&applet->ethernet_class, applet_device_ethernet_get_class, applet);
 	else if (NM_IS_DEVICE_WIFI (device))
-		return applet->wifi_class;
+		return ensure_device_class (&applet->wifi_class, applet_device_wifi_get_class, applet);
 	else if (NM_IS_DEVICE_MODEM (device)) {
 #if WITH_WWAN
-		return applet->broadband_class;
+		return ensure_device_class (&applet->broadband_class, applet_device_broadband_get_class, applet);
 #else
 		g_debug ("%s: modem found but WWAN support not enabled", __func__);
 #endif
 	} else if (NM_IS_DEVICE_BT (device))
-		return applet->bt_class;
+		return ensure_device_class (&applet->bt_class, applet_device_bt_get_class, applet);
 	else
 		g_debug ("%s: Unknown device type '%s'", __func__, G_OBJECT_TYPE_NAME (device));
 	return NULL;
@@ -160,15 +178,15 @@ get_device_class_from_connection (NMConnection *connection, NMApplet *applet)
 	g_return_val_if_fail (ctype != NULL, NULL);
 
 	if (!strcmp (ctype, NM_SETTING_WIRED_SETTING_NAME) || !strcmp (ctype, NM_SETTING_PPPOE_SETTING_NAME))
-		return applet->ethernet_class;
+		return ensure_device_class (&applet->ethernet_class, applet_device_ethernet_get_class, applet);
 	else if (!strcmp (ctype, NM_SETTING_WIRELESS_SETTING_NAME))
-		return applet->wifi_class;
+		return ensure_device_class (&applet->wifi_class, applet_device_wifi_get_class, applet);
 #if WITH_WWAN
 	else if (!strcmp (ctype, NM_SETTING_GSM_SETTING_NAME) || !strcmp (ctype, NM_SETTING_CDMA_SETTING_NAME))
-		return applet->broadband_class;
+		return ensure_device_class (&applet->broadband_class, applet_device_broadband_get_class, applet);
 #endif
 	else if (!strcmp (ctype, NM_SETTING_BLUETOOTH_SETTING_NAME))
-		return applet->bt_class;
+		return ensure_device_class (&applet->bt_class, applet_device_bt_get_class, applet);
 	else
 		g_warning ("%s: unhandled connection type '%s'", __func__, ctype);
 	return NULL;
@@ -1564,6 +1582,11 @@ static void nma_menu_show_cb (GtkWidget *menu, NMApplet *applet)
 	if (applet->status_icon)
 		gtk_status_icon_set_tooltip_text (applet->status_icon, NULL);
 
+	if (!applet->nm_client) {
+		nma_menu_add_text_item (menu, _("Connecting to NetworkManager…"));
+		return;
+	}
+
 	if (!nm_client_get_nm_running (applet->nm_client)) {
 		nma_menu_add_text_item (menu, _("NetworkManager is not running…"));
 		return;
@@ -1637,6 +1660,15 @@ nma_context_menu_update (NMApplet *applet)
 	gboolean notifications_enabled = TRUE;
 	gboolean sensitive = FALSE;
 
+	if (!applet->nm_client) {
+		/* Still waiting for the NMClient to become ready */
+		gtk_widget_set_sensitive (applet->info_menu_item, FALSE);
+		gtk_widget_set_sensitive (applet->networking_enabled_item, FALSE);
+		gtk_widget_hide (applet->wifi_enabled_item);
+		gtk_widget_hide (applet->wwan_enabled_item);
+		return;
+	}
+
 	state = nm_client_get_state (applet->nm_client);
 	sensitive = (   state == NM_STATE_CONNECTED_LOCAL
 	             || state == NM_STATE_CONNECTED_SITE
@@ -1955,6 +1987,8 @@ applet_update_menu (gpointer user_data)
 	NMApplet *applet = NM_APPLET (user_data);
 	GList *children, *elt;
 	GtkMenu *menu;
+	gint64 start_time = g_get_monotonic_time ();
+	gint64 end_time;
 
 	if (INDICATOR_ENABLED (applet)) {
 #ifdef WITH_APPINDICATOR
@@ -1994,6 +2028,10 @@ applet_update_menu (gpointer user_data)
 	} else
 		nma_menu_show_cb (GTK_WIDGET (menu), applet);
 
+	end_time = g_get_monotonic_time ();
+	applet_histogram_add (&applet->stats.menu_update_time, end_time - start_time);
+	applet_trace_complete ("applet", "update-menu", start_time, end_time);
+
 out:
 	applet->update_menu_id = 0;
 	return G_SOURCE_REMOVE;
@@ -2170,14 +2208,31 @@ foo_device_state_changed_cb (NMDevice *device,
 	applet_schedule_update_menu (applet);
 }
 
+#if WITH_WWAN
+static void mm1_client_setup (NMApplet *applet);
+#endif
+
 static void
 foo_device_added_cb (NMClient *client, NMDevice *device, gpointer user_data)
 {
 	NMApplet *applet = NM_APPLET (user_data);
 	NMADeviceClass *dclass;
+	gboolean add = TRUE;
+
+#if WITH_WWAN
+	/* ModemManager is only talked to once there's a modem.  Until its
+	 * client is ready, modems are added from mm1_name_owner_changed_cb(). */
+	if (NM_IS_DEVICE_MODEM (device) && !applet->mm1) {
+		if (!applet->mm1_requested) {
+			applet->mm1_requested = TRUE;
+			mm1_client_setup (applet);
+		}
+		add = FALSE;
+	}
+#endif
 
 	dclass = get_device_class (device, applet);
-	if (dclass && dclass->device_added)
+	if (add && dclass && dclass->device_added)
 		dclass->device_added (device, applet);
 
 	g_signal_connect (device, "state-changed",
@@ -2316,57 +2371,15 @@ foo_set_initial_state (gpointer data)
 
 	applet_schedule_update_icon (applet);
 
-	return FALSE;
-}
-
-static void
-foo_client_setup (NMApplet *applet)
-{
-	NMClientPermission perm;
-
-	applet->nm_client = nm_client_new (NULL, NULL);
-	if (!applet->nm_client)
-		return;
-
-	g_signal_connect (applet->nm_client, "notify::state",
-	                  G_CALLBACK (foo_client_state_changed_cb),
-	                  applet);
-	g_signal_connect (applet->nm_client, "notify::active-connections",
-	                  G_CALLBACK (foo_active_connections_changed_cb),
-	                  applet);
-	g_signal_connect (applet->nm_client, "device-added",
-	                  G_CALLBACK (foo_device_added_cb),
-	                  applet);
-	if (INDICATOR_ENABLED (applet)) {
-		g_signal_connect (applet->nm_client, "device-removed",
-		                  G_CALLBACK (foo_device_removed_cb),
-		                  applet);
-	}
-	g_signal_connect (applet->nm_client, "notify::manager-running",
-	                  G_CALLBACK (foo_manager_running_cb),
-	                  applet);
-
-	g_signal_connect (applet->nm_client, "permission-changed",
-	                  G_CALLBACK (foo_manager_permission_changed),
-	                  applet);
-
-	g_signal_connect (applet->nm_client, "notify::wireless-enabled",
-	                  G_CALLBACK (foo_wireless_enabled_changed_cb),
-	                  applet);
-
-	g_signal_connect (applet->nm_client, "notify::wwan-enabled",
-	                  G_CALLBACK (foo_wireless_enabled_changed_cb),
-	                  applet);
-
-	/* Initialize permissions - the initial 'permission-changed' signal is emitted from NMClient constructor, and thus not caught */
-	for (perm = NM_CLIENT_PERMISSION_NONE + 1; perm <= NM_CLIENT_PERMISSION_LAST; perm++) {
-		applet->permissions[perm] = nm_client_get_permission_result (applet->nm_client, perm);
-	}
-
-	if (nm_client_get_nm_running (applet->nm_client))
-		g_idle_add (foo_set_initial_state, applet);
+	/* The devices, and their device classes, are set up now */
+	applet->initial_state_time = g_get_monotonic_time ();
+	applet->startup_rss_kb = applet_get_rss_kb ();
+	g_debug ("Initial state set after %" G_GINT64_FORMAT " ms, RSS %" G_GUINT64_FORMAT " kB",
+	         (applet->initial_state_time - applet->startup_time) / 1000,
+	         applet->startup_rss_kb);
+	applet_trace_complete ("startup", "initial-state", applet->client_ready_time, applet->initial_state_time);
 
-	applet_schedule_update_icon (applet);
+	return FALSE;
 }
 
 #if WITH_WWAN
@@ -2426,23 +2439,31 @@ mm_new_ready (GDBusConnection *connection,
 }
 
 static void
-mm1_client_setup (NMApplet *applet)
+mm1_bus_get_ready (GObject *source_object,
+                   GAsyncResult *res,
+                   gpointer user_data)
 {
-	GDBusConnection *system_bus;
-	GError *error = NULL;
+	NMApplet *applet = NM_APPLET (user_data);
+	gs_unref_object GDBusConnection *system_bus = NULL;
+	gs_free_error GError *error = NULL;
 
-	system_bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
-	if (system_bus) {
-		mm_manager_new (system_bus,
-		                G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_DO_NOT_AUTO_START,
-		                NULL,
-		                (GAsyncReadyCallback) mm_new_ready,
-		                applet);
-		g_object_unref (system_bus);
-	} else {
+	system_bus = g_bus_get_finish (res, &error);
+	if (!system_bus) {
 		g_warning ("Error connecting to system D-Bus: %s", error->message);
-		g_clear_error (&error);
+		return;
 	}
+
+	mm_manager_new (system_bus,
+	                G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_DO_NOT_AUTO_START,
+	                NULL,
+	                (GAsyncReadyCallback) mm_new_ready,
+	                applet);
+}
+
+static void
+mm1_client_setup (NMApplet *applet)
+{
+	g_bus_get (G_BUS_TYPE_SYSTEM, NULL, mm1_bus_get_ready, applet);
 }
 
 #endif /* WITH_WWAN */
@@ -2612,22 +2633,23 @@ applet_update_icon (gpointer user_data)
 	gs_free char *icon_name_free = NULL;
 	gs_free char *dev_tip_free = NULL;
 	NMVpnConnectionState vpn_state = NM_VPN_CONNECTION_STATE_UNKNOWN;
-	gboolean nm_running;
+	gboolean nm_running, loading;
 	NMActiveConnection *active_vpn = NULL;
+	gint64 start_time = g_get_monotonic_time ();
+	gint64 end_time;
 
 	applet->update_icon_id = 0;
 
-	nm_running = nm_client_get_nm_running (applet->nm_client);
+	loading = !applet->nm_client && !applet->nm_client_failed;
+	nm_running = applet->nm_client && nm_client_get_nm_running (applet->nm_client);
 
 	/* Handle device state first */
 
-	state = nm_client_get_state (applet->nm_client);
-	if (!nm_running)
-		state = NM_STATE_UNKNOWN;
+	state = nm_running ? nm_client_get_state (applet->nm_client) : NM_STATE_UNKNOWN;
 
 #ifdef WITH_APPINDICATOR
 	if (INDICATOR_ENABLED (applet))
-		app_indicator_set_status (applet->app_indicator, nm_running ? APP_INDICATOR_STATUS_ACTIVE : APP_INDICATOR_STATUS_PASSIVE);
+		app_indicator_set_status (applet->app_indicator, (nm_running || loading) ? APP_INDICATOR_STATUS_ACTIVE : APP_INDICATOR_STATUS_PASSIVE);
 	else
 #endif  /* WITH_APPINDICATOR */
 	{
@@ -2636,6 +2658,12 @@ applet_update_icon (gpointer user_data)
 
 	switch (state) {
 	case NM_STATE_UNKNOWN:
+		if (loading) {
+			icon_name = "nm-no-connection";
+			dev_tip = _("Connecting to NetworkManager…");
+			break;
+		}
+		/* fall through */
 	case NM_STATE_ASLEEP:
 		icon_name = "nm-no-connection";
 		dev_tip = _("Networking disabled");
@@ -2657,7 +2685,8 @@ applet_update_icon (gpointer user_data)
 	g_clear_pointer (&icon_name_free, g_free);
 
 	/* VPN state next */
-	active_vpn = applet_get_active_vpn_connection (applet, &vpn_state);
+	if (applet->nm_client)
+		active_vpn = applet_get_active_vpn_connection (applet, &vpn_state);
 	if (active_vpn) {
 		switch (vpn_state) {
 		case NM_VPN_CONNECTION_STATE_ACTIVATED:
@@ -2706,6 +2735,17 @@ applet_update_icon (gpointer user_data)
 			gtk_status_icon_set_title (applet->status_icon, applet->tip);
 	}
 
+	end_time = g_get_monotonic_time ();
+	applet_histogram_add (&applet->stats.icon_update_time, end_time - start_time);
+	applet_trace_complete ("applet", "update-icon", start_time, end_time);
+
+	if (!applet->first_icon_time) {
+		applet->first_icon_time = g_get_monotonic_time ();
+		g_debug ("time to first icon: %" G_GINT64_FORMAT " ms",
+		         (applet->first_icon_time - applet->startup_time) / 1000);
+		applet_trace_complete ("startup", "first-icon", applet->startup_time, applet->first_icon_time);
+	}
+
 	return FALSE;
 }
 
@@ -2744,9 +2784,28 @@ applet_secrets_request_new (size_t totsize,
 	req->callback = callback;
 	req->callback_data = callback_data;
 	req->applet = applet;
+	req->stage_start[APPLET_AGENT_STAGE_DIALOG_WAIT] = g_get_monotonic_time ();
+
+	applet_trace_async_begin ("secrets", "secrets-request", req);
 	return req;
 }
 
+void
+applet_secrets_request_stage_begin (SecretsRequest *req, AppletAgentStage stage)
+{
+	req->stage_start[stage] = g_get_monotonic_time ();
+}
+
+void
+applet_secrets_request_stage_end (SecretsRequest *req, AppletAgentStage stage)
+{
+	if (req->stage_start[stage] && req->applet->agent) {
+		applet_agent_add_stage_time (req->applet->agent, req->connection, stage,
+		                             req->stage_start[stage], g_get_monotonic_time ());
+	}
+	req->stage_start[stage] = 0;
+}
+
 void
 applet_secrets_request_set_free_func (SecretsRequest *req,
                                       SecretsRequestFreeFunc free_func)
@@ -2773,7 +2832,7 @@ applet_secrets_request_complete_setting (SecretsRequest *req,
 	if (setting_name && !error) {
 		setting = nm_connection_get_setting_by_name (req->connection, setting_name);
 		if (setting) {
-			secrets_dict = nm_connection_to_dbus (req->connection, NM_CONNECTION_SERIALIZE_ALL);
+			secrets_dict = utils_connection_secrets_to_dbus (req->connection, setting_name, NULL);
 			if (!secrets_dict) {
 				g_set_error (&error,
 				             NM_SECRET_AGENT_ERROR,
@@ -2801,7 +2860,9 @@ applet_secrets_request_free (SecretsRequest *req)
 	if (req->free_func)
 		req->free_func (req);
 
-	req->applet->secrets_reqs = g_slist_remove (req->applet->secrets_reqs, req);
+	g_hash_table_remove (req->applet->secrets_reqs, req->reqid);
+
+	applet_trace_async_end ("secrets", "secrets-request", req);
 
 	g_object_unref (req->connection);
 	g_free (req->setting_name);
@@ -2811,13 +2872,8 @@ applet_secrets_request_free (SecretsRequest *req)
 }
 
 static void
-get_existing_secrets_cb (NMSecretAgentOld *agent,
-                         NMConnection *connection,
-                         GVariant *secrets,
-                         GError *secrets_error,
-                         gpointer user_data)
+get_existing_secrets_done (SecretsRequest *req, NMConnection *connection, GVariant *secrets)
 {
-	SecretsRequest *req = user_data;
 	NMADeviceClass *dclass;
 	GError *error = NULL;
 
@@ -2839,6 +2895,16 @@ get_existing_secrets_cb (NMSecretAgentOld *agent,
 	/* Otherwise success; wait for the secrets callback */
 }
 
+static void
+get_existing_secrets_cb (NMSecretAgentOld *agent,
+                         NMConnection *connection,
+                         GVariant *secrets,
+                         GError *secrets_error,
+                         gpointer user_data)
+{
+	get_existing_secrets_done (user_data, connection, secrets);
+}
+
 static void
 applet_agent_get_secrets_cb (AppletAgent *agent,
                              gpointer request_id,
@@ -2846,6 +2912,7 @@ applet_agent_get_secrets_cb (AppletAgent *agent,
                              const char *setting_name,
                              const char **hints,
                              guint32 flags,
+                             GVariant *existing_secrets,
                              AppletAgentSecretsCallback callback,
                              gpointer callback_data,
                              gpointer user_data)
@@ -2873,7 +2940,7 @@ applet_agent_get_secrets_cb (AppletAgent *agent,
 		if (!applet_vpn_request_get_secrets (req, &error))
 			goto error;
 
-		applet->secrets_reqs = g_slist_prepend (applet->secrets_reqs, req);
+		g_hash_table_insert (applet->secrets_reqs, req->reqid, req);
 		return;
 	}
 
@@ -2904,7 +2971,13 @@ applet_agent_get_secrets_cb (AppletAgent *agent,
 	                                  callback,
 	                                  callback_data,
 	                                  applet);
-	applet->secrets_reqs = g_slist_prepend (applet->secrets_reqs, req);
+	g_hash_table_insert (applet->secrets_reqs, req->reqid, req);
+
+	/* The agent usually just searched the keyring before asking us */
+	if (existing_secrets) {
+		get_existing_secrets_done (req, connection, existing_secrets);
+		return;
+	}
 
 	/* Get existing secrets, if any */
 	nm_secret_agent_old_get_secrets (NM_SECRET_AGENT_OLD (applet->agent),
@@ -2931,19 +3004,12 @@ applet_agent_cancel_secrets_cb (AppletAgent *agent,
                                 gpointer user_data)
 {
 	NMApplet *applet = NM_APPLET (user_data);
-	GSList *iter, *next;
-
-	for (iter = applet->secrets_reqs; iter; iter = next) {
-		SecretsRequest *req = iter->data;
-
-		next = g_slist_next (iter);
+	SecretsRequest *req;
 
-		if (req->reqid == request_id) {
-			/* cancel and free this password request */
-			applet_secrets_request_free (req);
-			break;
-		}
-	}
+	/* cancel and free this password request */
+	req = g_hash_table_lookup (applet->secrets_reqs, request_id);
+	if (req)
+		applet_secrets_request_free (req);
 }
 
 /*****************************************************************************/
@@ -2969,8 +3035,11 @@ nma_icon_check_and_load (const char *name, NMApplet *applet)
 	g_assert (applet != NULL);
 
 	/* icon already loaded successfully */
-	if (g_hash_table_lookup_extended (applet->icon_cache, name, NULL, (gpointer) &icon))
+	if (g_hash_table_lookup_extended (applet->icon_cache, name, NULL, (gpointer) &icon)) {
+		applet->stats.icon_cache_hits++;
 		return icon;
+	}
+	applet->stats.icon_cache_misses++;
 
 	scale = gdk_window_get_scale_factor (gdk_get_default_root_window ());
 
@@ -3203,6 +3272,51 @@ applet_embedded_cb (GObject *object, GParamSpec *pspec, gpointer user_data)
 	         embedded ? "embedded in" : "removed from");
 }
 
+static void
+applet_gsettings_secret_cache_changed (GSettings *settings,
+                                       gchar *key,
+                                       gpointer user_data)
+{
+	NMApplet *applet = NM_APPLET (user_data);
+
+	if (applet->agent) {
+		applet_agent_set_secret_cache_timeout (applet->agent,
+		                                       g_settings_get_uint (settings, PREF_SECRET_CACHE_TIMEOUT));
+	}
+}
+
+static void
+applet_gsettings_save_concurrency_changed (GSettings *settings,
+                                           gchar *key,
+                                           gpointer user_data)
+{
+	NMApplet *applet = NM_APPLET (user_data);
+
+	if (applet->agent) {
+		applet_agent_set_save_concurrency (applet->agent,
+		                                   g_settings_get_uint (settings, PREF_KEYRING_SAVE_CONCURRENCY));
+	}
+}
+
+static void
+applet_gsettings_warm_auth_dialogs_changed (GSettings *settings,
+                                            gchar *key,
+                                            gpointer user_data)
+{
+	gs_strfreev char **service_types = NULL;
+
+	service_types = g_settings_get_strv (settings, PREF_VPN_WARM_AUTH_DIALOGS);
+	applet_vpn_request_set_warm_auth_dialogs ((const char *const*) service_types);
+}
+
+static void
+applet_gsettings_auth_dialog_timeout_changed (GSettings *settings,
+                                              gchar *key,
+                                              gpointer user_data)
+{
+	applet_vpn_request_set_timeout (g_settings_get_uint (settings, PREF_VPN_AUTH_DIALOG_TIMEOUT));
+}
+
 static void
 register_agent (NMApplet *applet)
 {
@@ -3226,6 +3340,19 @@ register_agent (NMApplet *applet)
 	g_signal_connect (applet->agent, APPLET_AGENT_CANCEL_SECRETS,
 	                  G_CALLBACK (applet_agent_cancel_secrets_cb), applet);
 
+	applet_gsettings_secret_cache_changed (applet->gsettings, PREF_SECRET_CACHE_TIMEOUT, applet);
+	g_signal_connect (applet->gsettings, "changed::" PREF_SECRET_CACHE_TIMEOUT,
+	                  G_CALLBACK (applet_gsettings_secret_cache_changed), applet);
+	applet_gsettings_save_concurrency_changed (applet->gsettings, PREF_KEYRING_SAVE_CONCURRENCY, applet);
+	g_signal_connect (applet->gsettings, "changed::" PREF_KEYRING_SAVE_CONCURRENCY,
+	                  G_CALLBACK (applet_gsettings_save_concurrency_changed), applet);
+	applet_gsettings_warm_auth_dialogs_changed (applet->gsettings, PREF_VPN_WARM_AUTH_DIALOGS, applet);
+	g_signal_connect (applet->gsettings, "changed::" PREF_VPN_WARM_AUTH_DIALOGS,
+	                  G_CALLBACK (applet_gsettings_warm_auth_dialogs_changed), applet);
+	applet_gsettings_auth_dialog_timeout_changed (applet->gsettings, PREF_VPN_AUTH_DIALOG_TIMEOUT, applet);
+	g_signal_connect (applet->gsettings, "changed::" PREF_VPN_AUTH_DIALOG_TIMEOUT,
+	                  G_CALLBACK (applet_gsettings_auth_dialog_timeout_changed), applet);
+
 	if (INDICATOR_ENABLED (applet)) {
 		/* Watch for new connections */
 		g_signal_connect_swapped (applet->nm_client, NM_CLIENT_CONNECTION_ADDED,
@@ -3234,6 +3361,86 @@ register_agent (NMApplet *applet)
 	}
 }
 
+static void
+foo_client_new_ready (GObject *source_object,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+	gs_unref_object NMApplet *applet = NM_APPLET (user_data);
+	gs_free_error GError *error = NULL;
+	NMClientPermission perm;
+
+	applet->nm_client = nm_client_new_finish (result, &error);
+	if (!applet->nm_client) {
+		g_warning ("Could not create NetworkManager client: %s", error->message);
+		/* Stop showing the icon as connecting */
+		applet->nm_client_failed = TRUE;
+		applet_schedule_update_icon (applet);
+		return;
+	}
+
+	applet->client_ready_time = g_get_monotonic_time ();
+	g_debug ("NetworkManager client ready after %" G_GINT64_FORMAT " ms",
+	         (applet->client_ready_time - applet->startup_time) / 1000);
+	applet_trace_complete ("startup", "nm-client-init", applet->startup_time, applet->client_ready_time);
+
+	g_signal_connect (applet->nm_client, "notify::state",
+	                  G_CALLBACK (foo_client_state_changed_cb),
+	                  applet);
+	g_signal_connect (applet->nm_client, "notify::active-connections",
+	                  G_CALLBACK (foo_active_connections_changed_cb),
+	                  applet);
+	g_signal_connect (applet->nm_client, "device-added",
+	                  G_CALLBACK (foo_device_added_cb),
+	                  applet);
+	if (INDICATOR_ENABLED (applet)) {
+		g_signal_connect (applet->nm_client, "device-removed",
+		                  G_CALLBACK (foo_device_removed_cb),
+		                  applet);
+	}
+	g_signal_connect (applet->nm_client, "notify::manager-running",
+	                  G_CALLBACK (foo_manager_running_cb),
+	                  applet);
+
+	g_signal_connect (applet->nm_client, "permission-changed",
+	                  G_CALLBACK (foo_manager_permission_changed),
+	                  applet);
+
+	g_signal_connect (applet->nm_client, "notify::wireless-enabled",
+	                  G_CALLBACK (foo_wireless_enabled_changed_cb),
+	                  applet);
+
+	g_signal_connect (applet->nm_client, "notify::wwan-enabled",
+	                  G_CALLBACK (foo_wireless_enabled_changed_cb),
+	                  applet);
+
+	applet_record_attach (applet->nm_client);
+
+	/* Initialize permissions - the initial 'permission-changed' signal is emitted from NMClient constructor, and thus not caught */
+	for (perm = NM_CLIENT_PERMISSION_NONE + 1; perm <= NM_CLIENT_PERMISSION_LAST; perm++) {
+		applet->permissions[perm] = nm_client_get_permission_result (applet->nm_client, perm);
+	}
+
+	if (with_agent)
+		register_agent (applet);
+
+	if (nm_client_get_nm_running (applet->nm_client))
+		g_idle_add (foo_set_initial_state, applet);
+
+	applet_schedule_update_icon (applet);
+	applet_schedule_update_menu (applet);
+
+	applet_trace_complete ("startup", "nm-client-ready", applet->client_ready_time, g_get_monotonic_time ());
+}
+
+static void
+foo_client_setup (NMApplet *applet)
+{
+	/* Don't block startup on the initial D-Bus round trips; the icon is shown
+	 * in a "loading" state until the client becomes ready. */
+	nm_client_new_async (NULL, foo_client_new_ready, g_object_ref (applet));
+}
+
 static void
 applet_gsettings_show_changed (GSettings *settings,
                                gchar *key,
@@ -3276,6 +3483,9 @@ applet_startup (GApplication *app, gpointer user_data)
 {
 	NMApplet *applet = NM_APPLET (app);
 	gs_free_error GError *error = NULL;
+	gint64 ts;
+
+	applet->startup_time = ts = g_get_monotonic_time ();
 
 	g_set_application_name (_("NetworkManager Applet"));
 	gtk_window_set_default_icon_name ("network-workgroup");
@@ -3290,46 +3500,37 @@ applet_startup (GApplication *app, gpointer user_data)
 		g_application_quit (app);
 		return;
 	}
+	applet_trace_complete ("startup", "load-ui", ts, g_get_monotonic_time ());
 
+	ts = g_get_monotonic_time ();
 	applet->gsettings = g_settings_new (APPLET_PREFS_SCHEMA);
 	applet->visible = g_settings_get_boolean (applet->gsettings, PREF_SHOW_APPLET);
 	g_signal_connect (applet->gsettings, "changed::show-applet",
 	                  G_CALLBACK (applet_gsettings_show_changed), applet);
+	applet_trace_complete ("startup", "gsettings", ts, g_get_monotonic_time ());
 
 	foo_client_setup (applet);
 
 	/* Load pixmaps and create applet widgets */
+	ts = g_get_monotonic_time ();
 	if (!setup_widgets (applet)) {
 		g_warning ("Could not initialize applet widgets.");
 		g_application_quit (app);
 		return;
 	}
 	g_assert (INDICATOR_ENABLED (applet) || applet->status_icon);
+	applet_trace_complete ("startup", "setup-widgets", ts, g_get_monotonic_time ());
 
+	ts = g_get_monotonic_time ();
 	applet->icon_cache = g_hash_table_new_full (g_str_hash,
 	                                            g_str_equal,
 	                                            g_free,
 	                                            nm_g_object_unref);
 	nma_icons_init (applet);
+	applet_trace_complete ("startup", "icons-init", ts, g_get_monotonic_time ());
 
-	/* Initialize device classes */
-	applet->ethernet_class = applet_device_ethernet_get_class (applet);
-	g_assert (applet->ethernet_class);
-
-	applet->wifi_class = applet_device_wifi_get_class (applet);
-	g_assert (applet->wifi_class);
-
-#if WITH_WWAN
-	applet->broadband_class = applet_device_broadband_get_class (applet);
-	g_assert (applet->broadband_class);
-#endif
-
-	applet->bt_class = applet_device_bt_get_class (applet);
-	g_assert (applet->bt_class);
-
-#if WITH_WWAN
-	mm1_client_setup (applet);
-#endif
+	/* Show the icon in its loading state right away */
+	applet_schedule_update_icon (applet);
 
 	if (applet->status_icon) {
 		/* Track embedding to help debug issues where user has removed the
@@ -3340,15 +3541,15 @@ applet_startup (GApplication *app, gpointer user_data)
 		applet_embedded_cb (G_OBJECT (applet->status_icon), NULL, NULL);
 	}
 
-	if (with_agent)
-		register_agent (applet);
-
 	g_application_hold (G_APPLICATION (applet));
+
+	applet_trace_complete ("startup", "applet-startup", applet->startup_time, g_get_monotonic_time ());
 }
 
 static void finalize (GObject *object)
 {
 	NMApplet *applet = NM_APPLET (object);
+	GList *reqs;
 
 	g_slice_free (NMADeviceClass, applet->ethernet_class);
 	g_slice_free (NMADeviceClass, applet->wifi_class);
@@ -3372,8 +3573,11 @@ static void finalize (GObject *object)
 	g_free (applet->tip);
 	nma_icons_free (applet);
 
-	while (g_slist_length (applet->secrets_reqs))
-		applet_secrets_request_free ((SecretsRequest *) applet->secrets_reqs->data);
+	/* Before the requests, so that freeing them doesn't start new helpers */
+	applet_vpn_request_set_warm_auth_dialogs (NULL);
+	reqs = g_hash_table_get_values (applet->secrets_reqs);
+	g_list_free_full (reqs, (GDestroyNotify) applet_secrets_request_free);
+	g_hash_table_destroy (applet->secrets_reqs);
 
 	g_clear_object (&applet->info_dialog_ui);
 	g_clear_object (&applet->gsettings);
@@ -3391,6 +3595,7 @@ static void finalize (GObject *object)
 static void nma_init (NMApplet *applet)
 {
 	applet->icon_size = 16;
+	applet->secrets_reqs = g_hash_table_new (g_direct_hash, g_direct_equal);
 
 #ifdef WITH_APPINDICATOR
 #ifdef GDK_WINDOWING_X11
@@ -3405,9 +3610,40 @@ static void nma_init (NMApplet *applet)
 	g_signal_connect (applet, "activate", G_CALLBACK (applet_activate), NULL);
 }
 
+static gboolean
+nma_dbus_register (GApplication *app,
+                   GDBusConnection *connection,
+                   const char *object_path,
+                   GError **error)
+{
+	gs_free_error GError *local = NULL;
+
+	if (!G_APPLICATION_CLASS (nma_parent_class)->dbus_register (app, connection, object_path, error))
+		return FALSE;
+
+	/* The debug interface is optional; don't fail registration over it */
+	if (!applet_debug_register (NM_APPLET (app), connection, object_path, &local))
+		g_warning ("Could not export debug interface: %s", local->message);
+
+	return TRUE;
+}
+
+static void
+nma_dbus_unregister (GApplication *app,
+                     GDBusConnection *connection,
+                     const char *object_path)
+{
+	applet_debug_unregister (NM_APPLET (app), connection);
+
+	G_APPLICATION_CLASS (nma_parent_class)->dbus_unregister (app, connection, object_path);
+}
+
 static void nma_class_init (NMAppletClass *klass)
 {
 	GObjectClass *oclass = G_OBJECT_CLASS (klass);
+	GApplicationClass *app_class = G_APPLICATION_CLASS (klass);
 
 	oclass->finalize = finalize;
+	app_class->dbus_register = nma_dbus_register;
+	app_class->dbus_unregister = nma_dbus_unregister;
 }
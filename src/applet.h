@@ -26,6 +26,7 @@
 #include <NetworkManager.h>
 
 #include "applet-agent.h"
+#include "applet-stats.h"
 
 #if WITH_WWAN
 #include <libmm-glib.h>
@@ -56,6 +57,11 @@ typedef struct {
 #define PREF_SUPPRESS_WIFI_NETWORKS_AVAILABLE     "suppress-wireless-networks-available"
 #define PREF_SUPPRESS_BROADBAND_UNLOCK_PROMPT     "suppress-broadband-unlock-prompt"
 #define PREF_SHOW_APPLET                          "show-applet"
+#define PREF_SECRET_CACHE_TIMEOUT                 "secret-cache-timeout"
+#define PREF_KEYRING_SAVE_CONCURRENCY             "keyring-save-concurrency"
+#define PREF_VPN_WARM_AUTH_DIALOGS                "vpn-warm-auth-dialogs"
+#define PREF_VPN_AUTH_DIALOG_TIMEOUT              "vpn-auth-dialog-timeout"
+#define PREF_BROADBAND_SIGNAL_HYSTERESIS          "broadband-signal-hysteresis"
 
 #define ICON_LAYER_LINK                           0
 #define ICON_LAYER_VPN                            1
@@ -71,6 +77,7 @@ typedef struct {
 	GApplication parent;
 
 	NMClient *nm_client;
+	gboolean nm_client_failed;
 	AppletAgent *agent;
 
 	GSettings *gsettings;
@@ -78,6 +85,7 @@ typedef struct {
 #if WITH_WWAN
 	MMManager *mm1;
 	gboolean   mm1_running;
+	gboolean   mm1_requested;
 #endif
 
 	gboolean visible;
@@ -85,7 +93,7 @@ typedef struct {
 	/* Permissions */
 	NMClientPermissionResult permissions[NM_CLIENT_PERMISSION_LAST + 1];
 
-	/* Device classes */
+	/* Device classes, set up once a device or connection needs them */
 	NMADeviceClass *ethernet_class;
 	NMADeviceClass *wifi_class;
 #if WITH_WWAN
@@ -97,6 +105,13 @@ typedef struct {
 	guint           update_icon_id;
 	char *          tip;
 
+	/* Startup timestamps (monotonic, in microseconds) */
+	gint64          startup_time;
+	gint64          client_ready_time;
+	gint64          initial_state_time;
+	gint64          first_icon_time;
+	guint64         startup_rss_kb;
+
 	/* Animation stuff */
 	int             animation_step;
 	guint           animation_id;
@@ -138,10 +153,19 @@ typedef struct {
 
 	GtkBuilder *    info_dialog_ui;
 
-	/* Tracker objects for secrets requests */
-	GSList *        secrets_reqs;
+	/* Tracker objects for secrets requests, by reqid */
+	GHashTable *    secrets_reqs;
 
 	guint           wifi_scan_id;
+
+	/* Performance counters, exported by applet-debug.c */
+	struct {
+		AppletHistogram menu_update_time;
+		AppletHistogram icon_update_time;
+		guint64         icon_cache_hits;
+		guint64         icon_cache_misses;
+	} stats;
+	guint           debug_registration_id;
 } NMApplet;
 
 typedef void (*AppletNewAutoConnectionCallback) (NMConnection *connection,
@@ -164,6 +188,9 @@ struct _SecretsRequest {
 
 	NMConnection *connection;
 
+	/* When the stages that are in progress started */
+	gint64 stage_start[APPLET_AGENT_STAGE_LAST + 1];
+
 	/* Class-specific stuff */
 	SecretsRequestFreeFunc free_func;
 };
@@ -177,6 +204,10 @@ void applet_secrets_request_complete_setting (SecretsRequest *req,
                                               const char *setting_name,
                                               GError *error);
 void applet_secrets_request_free (SecretsRequest *req);
+void applet_secrets_request_stage_begin (SecretsRequest *req,
+                                         AppletAgentStage stage);
+void applet_secrets_request_stage_end (SecretsRequest *req,
+                                       AppletAgentStage stage);
 
 struct NMADeviceClass {
 	gboolean       (*new_auto_connection)  (NMDevice *device,
@@ -12,8 +12,12 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <glib-unix.h>
 
 #include "applet.h"
+#include "applet-record.h"
+#include "applet-trace.h"
 
 gboolean shell_debug = FALSE;
 gboolean with_agent = TRUE;
@@ -29,15 +33,40 @@ usage (const char *progname)
 	                 basename,
 	                 _("This program is a component of NetworkManager (https://networkmanager.dev)."),
 	                 _("It is not intended for command-line interaction but instead runs in the GNOME desktop environment."));
+
+	fprintf (stdout, "%s\n%s\n%s\n%s\n%s\n\n",
+	                 _("Debugging options:"),
+	                 _("  --trace         Write a timing trace to nm-applet-trace.json in the user cache directory"),
+	                 _("  --trace=FILE    Write the timing trace to FILE; NMA_TRACE=FILE does the same,"
+	                   " and NMA_TRACE=1 is like --trace"),
+	                 _("  --record=FILE   Record the NetworkManager events the applet reacts to in FILE"),
+	                 _("The trace is written on SIGUSR1 and when the applet exits."));
+}
+
+/* So that the trace and the recording are written when the session ends */
+static gboolean
+quit_signal_cb (gpointer user_data)
+{
+	g_application_quit (G_APPLICATION (user_data));
+	return G_SOURCE_CONTINUE;
 }
 
 int main (int argc, char *argv[])
 {
 	GApplication *applet;
 	char *fake_args[1] = { argv[0] };
+	const char *trace_file;
+	const char *record_file = NULL;
+	gboolean with_trace;
 	guint32 i;
 	int status;
 
+	/* NMA_TRACE=1 traces to the default location, anything else is a file name */
+	trace_file = g_getenv ("NMA_TRACE");
+	with_trace = trace_file && *trace_file;
+	if (with_trace && !strcmp (trace_file, "1"))
+		trace_file = NULL;
+
 	for (i = 1; i < argc; i++) {
 		if (!strcmp (argv[i], "--help")) {
 			usage (argv[0]);
@@ -47,6 +76,14 @@ int main (int argc, char *argv[])
 			shell_debug = TRUE;
 		else if (!strcmp (argv[i], "--no-agent"))
 			with_agent = FALSE;
+		else if (!strcmp (argv[i], "--trace")) {
+			with_trace = TRUE;
+			trace_file = NULL;
+		} else if (g_str_has_prefix (argv[i], "--trace=")) {
+			with_trace = TRUE;
+			trace_file = argv[i] + strlen ("--trace=");
+		} else if (g_str_has_prefix (argv[i], "--record="))
+			record_file = argv[i] + strlen ("--record=");
 		else if (!strcmp (argv[i], "--indicator")) {
 #ifdef WITH_APPINDICATOR
 			with_appindicator = TRUE;
@@ -56,6 +93,9 @@ int main (int argc, char *argv[])
 		}
 	}
 
+	/* Writes to a VPN auth dialog that exited early must fail, not kill us */
+	signal (SIGPIPE, SIG_IGN);
+
 	bindtextdomain (GETTEXT_PACKAGE, NMALOCALEDIR);
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 #ifndef WITH_APPINDICATOR
@@ -67,12 +107,22 @@ int main (int argc, char *argv[])
 	gtk_init (&argc, &argv);
 	textdomain (GETTEXT_PACKAGE);
 
+	if (with_trace)
+		applet_trace_init (trace_file);
+	if (record_file)
+		applet_record_init (record_file);
+
 	applet = g_object_new (NM_TYPE_APPLET,
 	                       "application-id", "org.freedesktop.network-manager-applet",
 	                       NULL);
+	g_unix_signal_add (SIGTERM, quit_signal_cb, applet);
+	g_unix_signal_add (SIGINT, quit_signal_cb, applet);
 	status = g_application_run (applet, 1, fake_args);
 	g_object_unref (applet);
 
+	applet_record_shutdown ();
+	applet_trace_shutdown ();
+
 	return status;
 }
 
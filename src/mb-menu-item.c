@@ -24,8 +24,14 @@ typedef struct {
 	GtkWidget *hbox;
 	GtkWidget *desc;
 
-	char *desc_string;
-	guint32    int_strength;
+	NMApplet *applet;
+	char *connection_name;
+	char *provider;
+	gboolean active;
+	guint32 technology;
+	guint32 state;
+	gboolean enabled;
+	guint32 int_strength;
 } NMMbMenuItemPrivate;
 
 static const char *
@@ -59,128 +65,218 @@ get_tech_name (guint32 tech)
 	}
 }
 
-static void
-update_label (NMMbMenuItem *item, gboolean use_bold)
+static char *
+get_desc_string (NMMbMenuItemPrivate *priv)
 {
-	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
-
-	gtk_label_set_use_markup (GTK_LABEL (priv->desc), use_bold);
-	if (use_bold) {
-		char *markup = g_markup_printf_escaped ("<b>%s</b>", priv->desc_string);
-
-		gtk_label_set_markup (GTK_LABEL (priv->desc), markup);
-		g_free (markup);
-	} else
-		gtk_label_set_text (GTK_LABEL (priv->desc), priv->desc_string);
-}
+	const char *connection_name = priv->connection_name;
+	const char *provider = priv->provider;
+	const char *tech_name = get_tech_name (priv->technology);
 
-GtkWidget *
-nm_mb_menu_item_new (const char *connection_name,
-                     guint32 strength,
-                     const char *provider,
-                     gboolean active,
-                     guint32 technology,
-                     guint32 state,
-                     gboolean enabled,
-                     NMApplet *applet)
-{
-	NMMbMenuItem *item;
-	NMMbMenuItemPrivate *priv;
-	const char *tech_name;
-
-	item = g_object_new (NM_TYPE_MB_MENU_ITEM, NULL);
-	g_assert (item);
-
-	priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
-	priv->int_strength = strength;
-
-	tech_name = get_tech_name (technology);
-
-	/* Construct the description string */
-	switch (state) {
+	switch (priv->state) {
 	default:
 	case MB_STATE_UNKNOWN:
-		priv->desc_string = g_strdup (_("not enabled"));
-		break;
+		return g_strdup (_("not enabled"));
 	case MB_STATE_IDLE:
 		if (connection_name)
-			priv->desc_string = g_strdup (connection_name);
+			return g_strdup (connection_name);
 		else
-			priv->desc_string = g_strdup (_("not registered"));
-		break;
+			return g_strdup (_("not registered"));
 	case MB_STATE_HOME:
 		if (connection_name) {
 			if (provider && tech_name)
-				priv->desc_string = g_strdup_printf ("%s (%s %s)", connection_name, provider, tech_name);
+				return g_strdup_printf ("%s (%s %s)", connection_name, provider, tech_name);
 			else if (provider || tech_name)
-				priv->desc_string = g_strdup_printf ("%s (%s)", connection_name, provider ? provider : tech_name);
+				return g_strdup_printf ("%s (%s)", connection_name, provider ? provider : tech_name);
 			else
-				priv->desc_string = g_strdup_printf ("%s", connection_name);
+				return g_strdup_printf ("%s", connection_name);
 		} else {
 			if (provider) {
 				if (tech_name)
-					priv->desc_string = g_strdup_printf ("%s %s", provider, tech_name);
+					return g_strdup_printf ("%s %s", provider, tech_name);
 				else
-					priv->desc_string = g_strdup_printf ("%s", provider);
+					return g_strdup_printf ("%s", provider);
 			} else {
 				if (tech_name)
-					priv->desc_string = g_strdup_printf (_("Home network (%s)"), tech_name);
+					return g_strdup_printf (_("Home network (%s)"), tech_name);
 				else
-					priv->desc_string = g_strdup_printf (_("Home network"));
+					return g_strdup_printf (_("Home network"));
 			}
 		}
-		break;
 	case MB_STATE_SEARCHING:
 		if (connection_name)
-			priv->desc_string = g_strdup (connection_name);
+			return g_strdup (connection_name);
 		else
-			priv->desc_string = g_strdup (_("searching"));
-		break;
+			return g_strdup (_("searching"));
 	case MB_STATE_DENIED:
-		priv->desc_string = g_strdup (_("registration denied"));
-		break;
+		return g_strdup (_("registration denied"));
 	case MB_STATE_ROAMING:
 		if (connection_name) {
 			if (tech_name)
-				priv->desc_string = g_strdup_printf (_("%s (%s roaming)"), connection_name, tech_name);
+				return g_strdup_printf (_("%s (%s roaming)"), connection_name, tech_name);
 			else
-				priv->desc_string = g_strdup_printf (_("%s (roaming)"), connection_name);
+				return g_strdup_printf (_("%s (roaming)"), connection_name);
 		} else {
 			if (provider) {
 				if (tech_name)
-					priv->desc_string = g_strdup_printf (_("%s (%s roaming)"), provider, tech_name);
+					return g_strdup_printf (_("%s (%s roaming)"), provider, tech_name);
 				else
-					priv->desc_string = g_strdup_printf (_("%s (roaming)"), provider);
+					return g_strdup_printf (_("%s (roaming)"), provider);
 			} else {
 				if (tech_name)
-					priv->desc_string = g_strdup_printf (_("Roaming network (%s)"), tech_name);
+					return g_strdup_printf (_("Roaming network (%s)"), tech_name);
 				else
-					priv->desc_string = g_strdup_printf (_("Roaming network"));
+					return g_strdup_printf (_("Roaming network"));
 			}
 		}
-		break;
 	}
+}
 
-	update_label (item, (enabled && connection_name && active));
+static void
+update_label (NMMbMenuItem *item)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+	gboolean use_bold = priv->enabled && priv->connection_name && priv->active;
+	gs_free char *desc_string = get_desc_string (priv);
 
-	/* And the strength icon, if we have strength information at all */
-	if (enabled && strength) {
-		const char *icon_name = mobile_helper_get_quality_icon_name (strength);
-		GdkPixbuf *icon = nma_icon_check_and_load (icon_name, applet);
+	gtk_label_set_use_markup (GTK_LABEL (priv->desc), use_bold);
+	if (use_bold) {
+		char *markup = g_markup_printf_escaped ("<b>%s</b>", desc_string);
 
-		if (INDICATOR_ENABLED (applet)) {
-			/* app_indicator only uses GdkPixbuf */
-			gtk_image_set_from_pixbuf (GTK_IMAGE (priv->strength), icon);
-		} else {
-			int scale = gtk_widget_get_scale_factor (GTK_WIDGET (priv->strength));
-			cairo_surface_t *surface;
+		gtk_label_set_markup (GTK_LABEL (priv->desc), markup);
+		g_free (markup);
+	} else
+		gtk_label_set_text (GTK_LABEL (priv->desc), desc_string);
+}
 
-			surface = gdk_cairo_surface_create_from_pixbuf (icon, scale, NULL);
-			gtk_image_set_from_surface (GTK_IMAGE (priv->strength), surface);
-			cairo_surface_destroy (surface);
-		}
+static void
+update_strength (NMMbMenuItem *item)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+	const char *icon_name;
+	GdkPixbuf *icon;
+
+	/* Only if we have strength information at all */
+	if (!priv->enabled || !priv->int_strength) {
+		gtk_image_clear (GTK_IMAGE (priv->strength));
+		return;
 	}
 
+	icon_name = mobile_helper_get_quality_icon_name (priv->int_strength);
+	icon = nma_icon_check_and_load (icon_name, priv->applet);
+
+	if (INDICATOR_ENABLED (priv->applet)) {
+		/* app_indicator only uses GdkPixbuf */
+		gtk_image_set_from_pixbuf (GTK_IMAGE (priv->strength), icon);
+	} else {
+		int scale = gtk_widget_get_scale_factor (GTK_WIDGET (priv->strength));
+		cairo_surface_t *surface;
+
+		surface = gdk_cairo_surface_create_from_pixbuf (icon, scale, NULL);
+		gtk_image_set_from_surface (GTK_IMAGE (priv->strength), surface);
+		cairo_surface_destroy (surface);
+	}
+}
+
+/* The setters only redo what depends on what changed */
+
+void
+nm_mb_menu_item_set_connection (NMMbMenuItem *item,
+                                const char *connection_name,
+                                gboolean active)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+
+	if (nm_streq0 (priv->connection_name, connection_name) && priv->active == active)
+		return;
+
+	g_free (priv->connection_name);
+	priv->connection_name = g_strdup (connection_name);
+	priv->active = active;
+	update_label (item);
+}
+
+void
+nm_mb_menu_item_set_provider (NMMbMenuItem *item, const char *provider)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+
+	if (nm_streq0 (priv->provider, provider))
+		return;
+
+	g_free (priv->provider);
+	priv->provider = g_strdup (provider);
+	update_label (item);
+}
+
+void
+nm_mb_menu_item_set_technology (NMMbMenuItem *item, guint32 technology)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+
+	if (priv->technology == technology)
+		return;
+
+	priv->technology = technology;
+	update_label (item);
+}
+
+void
+nm_mb_menu_item_set_state (NMMbMenuItem *item, guint32 state, gboolean enabled)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+
+	if (priv->state == state && priv->enabled == enabled)
+		return;
+
+	priv->state = state;
+	if (priv->enabled != enabled) {
+		priv->enabled = enabled;
+		update_strength (item);
+	}
+	update_label (item);
+}
+
+void
+nm_mb_menu_item_set_strength (NMMbMenuItem *item, guint32 strength)
+{
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+
+	if (priv->int_strength == strength)
+		return;
+
+	priv->int_strength = strength;
+	update_strength (item);
+}
+
+GtkWidget *
+nm_mb_menu_item_new (const char *connection_name,
+                     guint32 strength,
+                     const char *provider,
+                     gboolean active,
+                     guint32 technology,
+                     guint32 state,
+                     gboolean enabled,
+                     NMApplet *applet)
+{
+	NMMbMenuItem *item;
+	NMMbMenuItemPrivate *priv;
+
+	item = g_object_new (NM_TYPE_MB_MENU_ITEM, NULL);
+	g_assert (item);
+
+	priv = NM_MB_MENU_ITEM_GET_PRIVATE (item);
+	priv->applet = applet;
+	priv->connection_name = g_strdup (connection_name);
+	priv->provider = g_strdup (provider);
+	priv->active = active;
+	priv->technology = technology;
+	priv->state = state;
+	priv->enabled = enabled;
+	priv->int_strength = strength;
+
+	update_label (item);
+	update_strength (item);
+
 	return GTK_WIDGET (item);
 }
 
@@ -209,7 +305,10 @@ nm_mb_menu_item_init (NMMbMenuItem *self)
 static void
 finalize (GObject *object)
 {
-	g_free (NM_MB_MENU_ITEM_GET_PRIVATE (object)->desc_string);
+	NMMbMenuItemPrivate *priv = NM_MB_MENU_ITEM_GET_PRIVATE (object);
+
+	g_free (priv->connection_name);
+	g_free (priv->provider);
 
 	G_OBJECT_CLASS (nm_mb_menu_item_parent_class)->finalize (object);
 }
@@ -41,5 +41,18 @@ GtkWidget *nm_mb_menu_item_new (const char *connection_name,
                                 gboolean enabled,
                                 NMApplet *applet);
 
+void       nm_mb_menu_item_set_connection (NMMbMenuItem *item,
+                                           const char *connection_name,
+                                           gboolean active);
+void       nm_mb_menu_item_set_provider (NMMbMenuItem *item,
+                                         const char *provider);
+void       nm_mb_menu_item_set_technology (NMMbMenuItem *item,
+                                           guint32 technology);
+void       nm_mb_menu_item_set_state (NMMbMenuItem *item,
+                                      guint32 state,
+                                      gboolean enabled);
+void       nm_mb_menu_item_set_strength (NMMbMenuItem *item,
+                                         guint32 strength);
+
 #endif /* _MB_MENU_ITEM_H_ */
 
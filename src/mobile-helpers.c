@@ -8,12 +8,15 @@
 
 #include "nm-default.h"
 
-#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
 
 #include <libsecret/secret.h>
 
 #include "utils.h"
 #include "mobile-helpers.h"
+#include "mobile-providers-index.h"
 #include "applet-dialogs.h"
 
 GdkPixbuf *
@@ -89,19 +92,59 @@ mobile_helper_get_status_pixbuf (guint32 quality,
 	return pixbuf;
 }
 
+/* The quality each signal level starts above */
+static const guint32 quality_thresholds[] = { 5, 30, 55, 80 };
+
+static const char *const quality_icon_names[] = {
+	"nm-signal-00",
+	"nm-signal-25",
+	"nm-signal-50",
+	"nm-signal-75",
+	"nm-signal-100",
+};
+
+/**
+ * mobile_helper_get_quality_level:
+ * @quality: the signal quality, in percent
+ *
+ * Returns: the signal level shown for @quality, from 0 to 4
+ */
+guint
+mobile_helper_get_quality_level (guint32 quality)
+{
+	guint level = 0;
+
+	while (level < G_N_ELEMENTS (quality_thresholds) && quality > quality_thresholds[level])
+		level++;
+	return level;
+}
+
+/**
+ * mobile_helper_update_quality_level:
+ * @level: the signal level shown
+ * @quality: the new signal quality, in percent
+ * @hysteresis: by how many points @quality must be past a level's threshold
+ *   for the level to change
+ *
+ * Returns: the signal level to show for @quality, which stays @level unless
+ *   @quality is clearly out of it
+ */
+guint
+mobile_helper_update_quality_level (guint level, guint32 quality, guint hysteresis)
+{
+	guint new_level = mobile_helper_get_quality_level (quality);
+
+	if (new_level > level)
+		return MAX (level, mobile_helper_get_quality_level (quality > hysteresis ? quality - hysteresis : 0));
+	if (new_level < level)
+		return MIN (level, mobile_helper_get_quality_level (quality + hysteresis));
+	return level;
+}
+
 const char *
 mobile_helper_get_quality_icon_name (guint32 quality)
 {
-	if (quality > 80)
-		return "nm-signal-100";
-	else if (quality > 55)
-		return "nm-signal-75";
-	else if (quality > 30)
-		return "nm-signal-50";
-	else if (quality > 5)
-		return "nm-signal-25";
-	else
-		return "nm-signal-00";
+	return quality_icon_names[mobile_helper_get_quality_level (quality)];
 }
 
 const char *
@@ -362,6 +405,8 @@ get_secrets_cb (GtkDialog *dialog,
 	MobileHelperSecretsInfo *info = (MobileHelperSecretsInfo *) req;
 	GError *error = NULL;
 
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_USER);
+
 	if (response == GTK_RESPONSE_OK) {
 		if (info->capability == NM_DEVICE_MODEM_CAPABILITY_GSM_UMTS) {
 			NMSettingGsm *setting;
@@ -548,6 +593,8 @@ mobile_helper_get_secrets (NMDeviceModemCapabilities capabilities,
 	gtk_window_set_position (GTK_WINDOW (widget), GTK_WIN_POS_CENTER_ALWAYS);
 	gtk_widget_realize (GTK_WIDGET (widget));
 	gtk_window_present (GTK_WINDOW (widget));
+	applet_secrets_request_stage_end (req, APPLET_AGENT_STAGE_DIALOG_WAIT);
+	applet_secrets_request_stage_begin (req, APPLET_AGENT_STAGE_USER);
 
 	return TRUE;
 }
@@ -618,79 +665,291 @@ mobile_helper_get_icon (NMDevice *device,
 
 /********************************************************************/
 
-char *
-mobile_helper_parse_3gpp_operator_name (NMAMobileProvidersDatabase **mpd, /* I/O */
-                                        const char *orig,
-                                        const char *op_code)
+/* The providers database is parsed from a multi-megabyte XML file, while
+ * only the operator names are needed, by MCC/MNC and by SID.  So those are
+ * compiled into a small index in the user's cache directory, which is mapped
+ * and binary searched.  The index is rebuilt, with the database loaded in a
+ * worker thread, when the database file changes.
+ */
+
+/* Set from mobile-broadband-provider-info's pkg-config file, if installed */
+#ifndef MOBILE_BROADBAND_PROVIDER_INFO_DATABASE
+#define MOBILE_BROADBAND_PROVIDER_INFO_DATABASE "/usr/share/mobile-broadband-provider-info/serviceproviders.xml"
+#endif
+
+typedef enum {
+	PROVIDERS_NONE,
+	PROVIDERS_LOADING,
+	PROVIDERS_LOADED,
+	PROVIDERS_FAILED,
+} ProvidersState;
+
+typedef struct {
+	MobileHelperProvidersFunc func;
+	gpointer user_data;
+} ProvidersWaiter;
+
+static struct {
+	ProvidersState state;
+	MobileProvidersIndex *index;
+	GSList *waiters;
+} providers;
+
+static char *
+providers_index_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nm-applet", "mobile-providers.idx", NULL);
+}
+
+static gboolean
+providers_index_use (GBytes *bytes, const GStatBuf *source)
+{
+	MobileProvidersIndex *index;
+
+	index = mobile_providers_index_new (bytes, source);
+	if (!index)
+		return FALSE;
+
+	mobile_providers_index_free (providers.index);
+	providers.index = index;
+	providers.state = PROVIDERS_LOADED;
+	return TRUE;
+}
+
+static gboolean
+providers_index_map (const GStatBuf *source)
+{
+	gs_free char *path = providers_index_path ();
+	gs_unref_bytes GBytes *index = NULL;
+	GMappedFile *mapped;
+
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	if (!mapped)
+		return FALSE;
+
+	index = g_mapped_file_get_bytes (mapped);
+	g_mapped_file_unref (mapped);
+	return providers_index_use (index, source);
+}
+
+static GBytes *
+providers_index_build (NMAMobileProvidersDatabase *mpd, const GStatBuf *source)
+{
+	MobileProvidersIndexBuilder *builder;
+	GHashTableIter iter;
+	NMACountryInfo *country;
+	GSList *l;
+
+	builder = mobile_providers_index_builder_new ();
+
+	g_hash_table_iter_init (&iter, nma_mobile_providers_database_get_countries (mpd));
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &country)) {
+		for (l = nma_country_info_get_providers (country); l; l = l->next) {
+			NMAMobileProvider *provider = l->data;
+			const char *name = nma_mobile_provider_get_name (provider);
+
+			if (!name)
+				continue;
+
+			mobile_providers_index_builder_add (builder,
+			                                    name,
+			                                    nma_mobile_provider_get_3gpp_mcc_mnc (provider),
+			                                    nma_mobile_provider_get_cdma_sid (provider));
+		}
+	}
+
+	return mobile_providers_index_builder_end (builder, source);
+}
+
+static void
+providers_index_save (GBytes *index)
+{
+	gs_free char *path = providers_index_path ();
+	gs_free char *dir = g_path_get_dirname (path);
+	gs_free_error GError *error = NULL;
+	gconstpointer data;
+	gsize len;
+
+	data = g_bytes_get_data (index, &len);
+	if (   g_mkdir_with_parents (dir, 0700) != 0
+	    || !g_file_set_contents (path, data, len, &error))
+		g_debug ("Couldn't save the mobile providers index: %s", error ? error->message : g_strerror (errno));
+}
+
+static void
+providers_loaded_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	GStatBuf *st = user_data;
+	gs_unref_object NMAMobileProvidersDatabase *mpd = NULL;
+	gs_unref_bytes GBytes *index = NULL;
+	gs_free_error GError *error = NULL;
+	GSList *waiters, *l;
+
+	mpd = nma_mobile_providers_database_new_finish (result, &error);
+	if (mpd) {
+		index = providers_index_build (mpd, st);
+		if (st)
+			providers_index_save (index);
+		providers_index_use (index, NULL);
+	} else {
+		g_warning ("Couldn't read database: %s", error->message);
+		providers.state = PROVIDERS_FAILED;
+	}
+	g_free (st);
+
+	waiters = g_slist_reverse (g_steal_pointer (&providers.waiters));
+	for (l = waiters; l; l = l->next) {
+		ProvidersWaiter *waiter = l->data;
+
+		waiter->func (waiter->user_data);
+	}
+	g_slist_free_full (waiters, g_free);
+}
+
+static void
+providers_load (void)
+{
+	GStatBuf *st = g_new (GStatBuf, 1);
+
+	/* The index is kept only if the database it's made from can be told
+	 * apart from a changed one.  Checked before loading, so that a change
+	 * while loading makes for a rebuild next time. */
+	if (g_stat (MOBILE_BROADBAND_PROVIDER_INFO_DATABASE, st) != 0)
+		g_clear_pointer (&st, g_free);
+	else if (providers_index_map (st)) {
+		g_free (st);
+		return;
+	}
+
+	providers.state = PROVIDERS_LOADING;
+	nma_mobile_providers_database_new (NULL, NULL, NULL, providers_loaded_cb, st);
+}
+
+/* Whether the index can be used.  If it's still to be loaded, @func is
+ * called with @user_data once it has been. */
+static gboolean
+providers_ready (MobileHelperProvidersFunc func, gpointer user_data)
 {
-	NMAMobileProvider *provider;
-	guint i, orig_len;
+	ProvidersWaiter *waiter;
+	GSList *l;
 
-	g_assert (mpd != NULL);
+	if (providers.state == PROVIDERS_NONE)
+		providers_load ();
+
+	switch (providers.state) {
+	case PROVIDERS_LOADED:
+		return TRUE;
+	case PROVIDERS_FAILED:
+		return FALSE;
+	default:
+		break;
+	}
+
+	if (!func)
+		return FALSE;
+
+	for (l = providers.waiters; l; l = l->next) {
+		waiter = l->data;
+		if (waiter->func == func && waiter->user_data == user_data)
+			return FALSE;
+	}
+
+	waiter = g_new (ProvidersWaiter, 1);
+	waiter->func = func;
+	waiter->user_data = user_data;
+	providers.waiters = g_slist_prepend (providers.waiters, waiter);
+	return FALSE;
+}
+
+/**
+ * mobile_helper_providers_cancel:
+ * @user_data: as passed to the operator name lookups
+ *
+ * Drops the pending notifications about the providers database having been
+ * loaded that were asked for with @user_data.
+ */
+void
+mobile_helper_providers_cancel (gpointer user_data)
+{
+	GSList *l, *next;
+
+	for (l = providers.waiters; l; l = next) {
+		ProvidersWaiter *waiter = l->data;
+
+		next = l->next;
+		if (waiter->user_data == user_data) {
+			g_free (waiter);
+			providers.waiters = g_slist_delete_link (providers.waiters, l);
+		}
+	}
+}
+
+/**
+ * mobile_helper_parse_3gpp_operator_name:
+ * @orig: the operator name
+ * @op_code: the operator MCC/MNC
+ * @loaded_func: (allow-none): called with @user_data once the providers
+ *   database has been loaded, if it's not loaded yet
+ * @user_data: data for @loaded_func
+ *
+ * Returns: the operator name to show.  If it has to be looked up by
+ *   the MCC/MNC while the providers database is loading, that's the
+ *   MCC/MNC.
+ */
+char *
+mobile_helper_parse_3gpp_operator_name (const char *orig,
+                                        const char *op_code,
+                                        MobileHelperProvidersFunc loaded_func,
+                                        gpointer user_data)
+{
+	const char *name;
 
 	/* Some devices return the MCC/MNC if they haven't fully initialized
 	 * or gotten all the info from the network yet.  Handle that.
 	 */
 
-	orig_len = orig ? strlen (orig) : 0;
-	if (orig_len == 0) {
+	if (!orig || !orig[0]) {
 		/* If the operator name isn't valid, maybe we can look up the MCC/MNC
 		 * from the operator code instead.
 		 */
-		if (op_code && strlen (op_code)) {
+		if (op_code && op_code[0])
 			orig = op_code;
-			orig_len = strlen (orig);
-		} else
+		else
 			return NULL;
-	} else if (orig_len < 5 || orig_len > 6)
-		return g_strdup (orig);  /* not an MCC/MNC */
-
-	for (i = 0; i < orig_len; i++) {
-		if (!isdigit (orig[i]))
-			return strdup (orig);
 	}
 
+	if (!mobile_providers_index_is_mcc_mnc (orig))
+		return g_strdup (orig);
+
 	/* At this point we have a 5 or 6 character all-digit string; that's
 	 * probably an MCC/MNC.  Look that up.
 	 */
 
-	if (*mpd == NULL) {
-		GError *error = NULL;
-
-		*mpd = nma_mobile_providers_database_new_sync (NULL, NULL, NULL, &error);
-		if (*mpd == NULL) {
-			g_warning ("Couldn't read database: %s", error->message);
-			g_error_free (error);
-			return strdup (orig);
-		}
-	}
+	if (!providers_ready (loaded_func, user_data))
+		return g_strdup (orig);
 
-	provider = nma_mobile_providers_database_lookup_3gpp_mcc_mnc (*mpd, orig);
-	return (provider ? g_strdup (nma_mobile_provider_get_name (provider)) : NULL);
+	name = mobile_providers_index_lookup_3gpp (providers.index, orig);
+	return g_strdup (name);
 }
 
+/**
+ * mobile_helper_parse_3gpp2_operator_name:
+ * @sid: the CDMA system identifier
+ * @loaded_func: (allow-none): as for mobile_helper_parse_3gpp_operator_name()
+ * @user_data: data for @loaded_func
+ *
+ * Returns: the operator name, or %NULL if it's not known (yet)
+ */
 char *
-mobile_helper_parse_3gpp2_operator_name (NMAMobileProvidersDatabase **mpd, /* I/O */
-                                         guint32 sid)
+mobile_helper_parse_3gpp2_operator_name (guint32 sid,
+                                         MobileHelperProvidersFunc loaded_func,
+                                         gpointer user_data)
 {
-	NMAMobileProvider *provider;
-
-	g_assert (mpd != NULL);
-
 	if (!sid)
 		return NULL;
 
-	if (*mpd == NULL) {
-		GError *error = NULL;
-
-		*mpd = nma_mobile_providers_database_new_sync (NULL, NULL, NULL, &error);
-		if (*mpd == NULL) {
-			g_warning ("Couldn't read database: %s", error->message);
-			g_error_free (error);
-			return NULL;
-		}
-	}
+	if (!providers_ready (loaded_func, user_data))
+		return NULL;
 
-	provider = nma_mobile_providers_database_lookup_cdma_sid (*mpd, sid);
-	return (provider ? g_strdup (nma_mobile_provider_get_name (provider)) : NULL);
+	return g_strdup (mobile_providers_index_lookup_3gpp2 (providers.index, sid));
 }
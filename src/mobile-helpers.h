@@ -47,6 +47,10 @@ GdkPixbuf *mobile_helper_get_status_pixbuf (guint32 quality,
                                             NMApplet *applet);
 
 const char *mobile_helper_get_quality_icon_name (guint32 quality);
+guint       mobile_helper_get_quality_level (guint32 quality);
+guint       mobile_helper_update_quality_level (guint level,
+                                                guint32 quality,
+                                                guint hysteresis);
 const char *mobile_helper_get_tech_icon_name (guint32 tech);
 
 /********************************************************************/
@@ -94,11 +98,17 @@ void mobile_helper_get_icon (NMDevice *device,
 
 /********************************************************************/
 
-char *mobile_helper_parse_3gpp_operator_name (NMAMobileProvidersDatabase **mpd,
-                                              const char *orig,
-                                              const char *op_code);
+typedef void (*MobileHelperProvidersFunc) (gpointer user_data);
 
-char *mobile_helper_parse_3gpp2_operator_name (NMAMobileProvidersDatabase **mpd,
-                                               guint32 sid);
+char *mobile_helper_parse_3gpp_operator_name (const char *orig,
+                                              const char *op_code,
+                                              MobileHelperProvidersFunc loaded_func,
+                                              gpointer user_data);
+
+char *mobile_helper_parse_3gpp2_operator_name (guint32 sid,
+                                               MobileHelperProvidersFunc loaded_func,
+                                               gpointer user_data);
+
+void mobile_helper_providers_cancel (gpointer user_data);
 
 #endif  /* APPLET_MOBILE_HELPERS_H */
@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mobile-providers-index.h"
+
+#define PROVIDERS_INDEX_MAGIC "NMAPRV02"
+
+/* Like the providers database lookup, an MCC/MNC matches a code with the
+ * same MCC and first two MNC digits, and a code that's the same as a whole
+ * is preferred.  So each code is indexed under both keys. */
+#define KEY_6_DIGITS  (1u << 31)
+#define KEY_PREFIX    (1u << 30)
+
+/* The index is the header, the MCC/MNC entries and the SID entries, each
+ * sorted by key, and the NUL-terminated names the entries point into. */
+typedef struct {
+	char magic[8];
+	guint64 source_mtime;
+	guint64 source_size;
+	guint32 n_mcc_mnc;
+	guint32 n_sid;
+	guint32 names_len;
+	guint32 reserved;
+} ProvidersIndexHeader;
+
+typedef struct {
+	guint32 code;
+	guint32 name;
+} ProvidersIndexEntry;
+
+struct _MobileProvidersIndex {
+	GBytes *bytes;
+	const ProvidersIndexEntry *mcc_mnc;
+	const ProvidersIndexEntry *sid;
+	const char *names;
+	guint32 n_mcc_mnc;
+	guint32 n_sid;
+	guint32 names_len;
+};
+
+struct _MobileProvidersIndexBuilder {
+	GArray *mcc_mnc;
+	GArray *sid;
+	GString *names;
+	GHashTable *name_offsets;
+};
+
+gboolean
+mobile_providers_index_is_mcc_mnc (const char *str)
+{
+	gsize i, len = strlen (str);
+
+	if (len < 5 || len > 6)
+		return FALSE;
+	for (i = 0; i < len; i++) {
+		if (!isdigit (str[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* The whole MCC/MNC, keeping the length of the MNC apart so that "00101"
+ * and "001001" don't collide. */
+static guint32
+mcc_mnc_key (const char *mcc_mnc)
+{
+	guint32 key = strtoul (mcc_mnc, NULL, 10);
+
+	if (strlen (mcc_mnc) == 6)
+		key |= KEY_6_DIGITS;
+	return key;
+}
+
+/* The MCC and the first two MNC digits */
+static guint32
+mcc_mnc_prefix_key (const char *mcc_mnc)
+{
+	char prefix[6];
+
+	memcpy (prefix, mcc_mnc, 5);
+	prefix[5] = '\0';
+	return strtoul (prefix, NULL, 10) | KEY_PREFIX;
+}
+
+/*****************************************************************************/
+
+MobileProvidersIndexBuilder *
+mobile_providers_index_builder_new (void)
+{
+	MobileProvidersIndexBuilder *builder = g_slice_new (MobileProvidersIndexBuilder);
+
+	builder->mcc_mnc = g_array_new (FALSE, FALSE, sizeof (ProvidersIndexEntry));
+	builder->sid = g_array_new (FALSE, FALSE, sizeof (ProvidersIndexEntry));
+	builder->names = g_string_new (NULL);
+	builder->name_offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	return builder;
+}
+
+/* Adds a provider.  Where several have the same code, the first one added
+ * is the one that's found. */
+void
+mobile_providers_index_builder_add (MobileProvidersIndexBuilder *builder,
+                                    const char *name,
+                                    const char *const*mcc_mncs,
+                                    const guint32 *sids)
+{
+	ProvidersIndexEntry entry;
+	gpointer offset;
+	guint i;
+
+	g_return_if_fail (name);
+
+	if (!g_hash_table_lookup_extended (builder->name_offsets, name, NULL, &offset)) {
+		offset = GUINT_TO_POINTER (builder->names->len);
+		g_string_append_len (builder->names, name, strlen (name) + 1);
+		g_hash_table_insert (builder->name_offsets, g_strdup (name), offset);
+	}
+	entry.name = GPOINTER_TO_UINT (offset);
+
+	for (i = 0; mcc_mncs && mcc_mncs[i]; i++) {
+		if (mobile_providers_index_is_mcc_mnc (mcc_mncs[i])) {
+			entry.code = mcc_mnc_key (mcc_mncs[i]);
+			g_array_append_val (builder->mcc_mnc, entry);
+			entry.code = mcc_mnc_prefix_key (mcc_mncs[i]);
+			g_array_append_val (builder->mcc_mnc, entry);
+		}
+	}
+	for (i = 0; sids && sids[i]; i++) {
+		entry.code = sids[i];
+		g_array_append_val (builder->sid, entry);
+	}
+}
+
+static gint
+entry_cmp (gconstpointer a, gconstpointer b)
+{
+	const ProvidersIndexEntry *ea = a, *eb = b;
+
+	return ea->code < eb->code ? -1 : (ea->code > eb->code);
+}
+
+/* Sorts the entries and keeps the first one of each key */
+static void
+entries_sort (GArray *entries)
+{
+	ProvidersIndexEntry *e;
+	guint i, j;
+
+	/* g_array_sort() is stable */
+	g_array_sort (entries, entry_cmp);
+
+	e = (ProvidersIndexEntry *) entries->data;
+	for (i = 0, j = 0; i < entries->len; i++) {
+		if (j && e[j - 1].code == e[i].code)
+			continue;
+		e[j++] = e[i];
+	}
+	g_array_set_size (entries, j);
+}
+
+/* Frees @builder and returns the index, recording the size and modification
+ * time of the database file it was made from, if any. */
+GBytes *
+mobile_providers_index_builder_end (MobileProvidersIndexBuilder *builder,
+                                    const GStatBuf *source)
+{
+	ProvidersIndexHeader header = { };
+	GString *index;
+
+	entries_sort (builder->mcc_mnc);
+	entries_sort (builder->sid);
+
+	if (!builder->names->len)
+		g_string_append_c (builder->names, '\0');
+
+	memcpy (header.magic, PROVIDERS_INDEX_MAGIC, sizeof (header.magic));
+	header.source_mtime = source ? source->st_mtime : 0;
+	header.source_size = source ? source->st_size : 0;
+	header.n_mcc_mnc = builder->mcc_mnc->len;
+	header.n_sid = builder->sid->len;
+	header.names_len = builder->names->len;
+
+	index = g_string_sized_new (sizeof (header)
+	                            + (header.n_mcc_mnc + header.n_sid) * sizeof (ProvidersIndexEntry)
+	                            + header.names_len);
+	g_string_append_len (index, (const char *) &header, sizeof (header));
+	g_string_append_len (index, builder->mcc_mnc->data, header.n_mcc_mnc * sizeof (ProvidersIndexEntry));
+	g_string_append_len (index, builder->sid->data, header.n_sid * sizeof (ProvidersIndexEntry));
+	g_string_append_len (index, builder->names->str, header.names_len);
+
+	g_array_unref (builder->mcc_mnc);
+	g_array_unref (builder->sid);
+	g_string_free (builder->names, TRUE);
+	g_hash_table_unref (builder->name_offsets);
+	g_slice_free (MobileProvidersIndexBuilder, builder);
+	return g_string_free_to_bytes (index);
+}
+
+/*****************************************************************************/
+
+/* Returns %NULL if @bytes is not a valid index, or, with @source, not one
+ * made from that database file. */
+MobileProvidersIndex *
+mobile_providers_index_new (GBytes *bytes, const GStatBuf *source)
+{
+	MobileProvidersIndex *index;
+	const ProvidersIndexHeader *header;
+	const guint8 *data;
+	gsize len;
+	guint64 entries_len;
+
+	data = g_bytes_get_data (bytes, &len);
+	if (len < sizeof (*header))
+		return NULL;
+
+	header = (const ProvidersIndexHeader *) data;
+	if (memcmp (header->magic, PROVIDERS_INDEX_MAGIC, sizeof (header->magic)) != 0)
+		return NULL;
+	if (   source
+	    && (   header->source_mtime != (guint64) source->st_mtime
+	        || header->source_size != (guint64) source->st_size))
+		return NULL;
+
+	entries_len = ((guint64) header->n_mcc_mnc + header->n_sid) * sizeof (ProvidersIndexEntry);
+	if (   sizeof (*header) + entries_len + header->names_len != len
+	    || header->names_len == 0
+	    || data[len - 1] != '\0')
+		return NULL;
+
+	index = g_slice_new (MobileProvidersIndex);
+	index->bytes = g_bytes_ref (bytes);
+	index->mcc_mnc = (const ProvidersIndexEntry *) (data + sizeof (*header));
+	index->sid = index->mcc_mnc + header->n_mcc_mnc;
+	index->names = (const char *) (index->sid + header->n_sid);
+	index->n_mcc_mnc = header->n_mcc_mnc;
+	index->n_sid = header->n_sid;
+	index->names_len = header->names_len;
+	return index;
+}
+
+void
+mobile_providers_index_free (MobileProvidersIndex *index)
+{
+	if (!index)
+		return;
+	g_bytes_unref (index->bytes);
+	g_slice_free (MobileProvidersIndex, index);
+}
+
+static const char *
+index_lookup (MobileProvidersIndex *index,
+              const ProvidersIndexEntry *entries,
+              guint32 n_entries,
+              guint32 code)
+{
+	guint32 lo = 0, hi = n_entries;
+
+	while (lo < hi) {
+		guint32 mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].code < code)
+			lo = mid + 1;
+		else if (entries[mid].code > code)
+			hi = mid;
+		else if (entries[mid].name < index->names_len)
+			return index->names + entries[mid].name;
+		else
+			return NULL;
+	}
+	return NULL;
+}
+
+const char *
+mobile_providers_index_lookup_3gpp (MobileProvidersIndex *index, const char *mcc_mnc)
+{
+	const char *name;
+
+	g_return_val_if_fail (index, NULL);
+	g_return_val_if_fail (mcc_mnc, NULL);
+
+	if (!mobile_providers_index_is_mcc_mnc (mcc_mnc))
+		return NULL;
+
+	name = index_lookup (index, index->mcc_mnc, index->n_mcc_mnc, mcc_mnc_key (mcc_mnc));
+	if (!name)
+		name = index_lookup (index, index->mcc_mnc, index->n_mcc_mnc, mcc_mnc_prefix_key (mcc_mnc));
+	return name;
+}
+
+const char *
+mobile_providers_index_lookup_3gpp2 (MobileProvidersIndex *index, guint32 sid)
+{
+	g_return_val_if_fail (index, NULL);
+
+	return index_lookup (index, index->sid, index->n_sid, sid);
+}
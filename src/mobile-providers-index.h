@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#ifndef MOBILE_PROVIDERS_INDEX_H
+#define MOBILE_PROVIDERS_INDEX_H
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+typedef struct _MobileProvidersIndex MobileProvidersIndex;
+typedef struct _MobileProvidersIndexBuilder MobileProvidersIndexBuilder;
+
+gboolean mobile_providers_index_is_mcc_mnc (const char *str);
+
+MobileProvidersIndexBuilder *mobile_providers_index_builder_new (void);
+
+void mobile_providers_index_builder_add (MobileProvidersIndexBuilder *builder,
+                                         const char *name,
+                                         const char *const*mcc_mncs,
+                                         const guint32 *sids);
+
+GBytes *mobile_providers_index_builder_end (MobileProvidersIndexBuilder *builder,
+                                            const GStatBuf *source);
+
+MobileProvidersIndex *mobile_providers_index_new (GBytes *bytes,
+                                                  const GStatBuf *source);
+
+void mobile_providers_index_free (MobileProvidersIndex *index);
+
+const char *mobile_providers_index_lookup_3gpp (MobileProvidersIndex *index,
+                                                const char *mcc_mnc);
+
+const char *mobile_providers_index_lookup_3gpp2 (MobileProvidersIndex *index,
+                                                 guint32 sid);
+
+#endif  /* MOBILE_PROVIDERS_INDEX_H */
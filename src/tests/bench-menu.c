@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2026 Red Hat, Inc.
+ */
+
+/* Measures how long it takes to build the tray menu.  This is expected to be
+ * run against the stand-in NetworkManager from mock-nm-service.py, through
+ * run-with-mock-nm.py (see meson.build for the "menu" benchmark).
+ */
+
+#include "nm-default.h"
+
+#include <stdlib.h>
+
+#include "applet.h"
+
+gboolean shell_debug = FALSE;
+gboolean with_agent = FALSE;
+gboolean with_appindicator = FALSE;
+
+static gboolean
+wakeup_cb (gpointer user_data)
+{
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+	g_main_loop_quit (user_data);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+settle (guint msec)
+{
+	GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+
+	g_timeout_add (msec, quit_cb, loop);
+	g_main_loop_run (loop);
+	g_main_loop_unref (loop);
+}
+
+static gboolean
+client_ready (NMApplet *applet)
+{
+	const GPtrArray *devices;
+
+	if (!applet->nm_client || !nm_client_get_nm_running (applet->nm_client))
+		return FALSE;
+
+	devices = nm_client_get_devices (applet->nm_client);
+	return devices && devices->len > 0;
+}
+
+static int
+compare_int64 (gconstpointer a, gconstpointer b)
+{
+	gint64 x = *(const gint64 *) a;
+	gint64 y = *(const gint64 *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+report (const char *name, GArray *samples)
+{
+	gint64 p50, p99, max;
+
+	if (!samples->len) {
+		g_print ("%s: n=0\n", name);
+		return;
+	}
+
+	g_array_sort (samples, compare_int64);
+	p50 = g_array_index (samples, gint64, samples->len / 2);
+	p99 = g_array_index (samples, gint64, MIN (samples->len - 1, samples->len * 99 / 100));
+	max = g_array_index (samples, gint64, samples->len - 1);
+
+	g_print ("%s: n=%u p50_us=%" G_GINT64_FORMAT " p99_us=%" G_GINT64_FORMAT " max_us=%" G_GINT64_FORMAT "\n",
+	         name, samples->len, p50, p99, max);
+}
+
+static void
+bench_update_menu (NMApplet *applet, guint iterations, GArray *samples)
+{
+	guint i;
+
+	/* applet_update_menu() only rebuilds a menu that is open */
+	applet->menu = g_object_ref_sink (gtk_menu_new ());
+
+	for (i = 0; i < iterations; i++) {
+		gint64 start = g_get_monotonic_time ();
+		gint64 elapsed;
+
+		applet_schedule_update_menu (applet);
+		while (applet->update_menu_id)
+			g_main_context_iteration (NULL, TRUE);
+
+		elapsed = g_get_monotonic_time () - start;
+		g_array_append_val (samples, elapsed);
+	}
+
+	gtk_widget_destroy (applet->menu);
+	g_clear_object (&applet->menu);
+}
+
+static void
+bench_wifi_add_menu_item (NMApplet *applet, guint iterations, GArray *samples)
+{
+	const GPtrArray *devices;
+	GPtrArray *all_connections;
+	guint n_wifi = 0;
+	guint i, j;
+
+	devices = nm_client_get_devices (applet->nm_client);
+	for (i = 0; i < devices->len; i++) {
+		if (NM_IS_DEVICE_WIFI (devices->pdata[i]))
+			n_wifi++;
+	}
+
+	all_connections = applet_get_all_connections (applet);
+
+	for (i = 0; i < devices->len; i++) {
+		NMDevice *device = devices->pdata[i];
+		gs_unref_ptrarray GPtrArray *connections = NULL;
+		NMActiveConnection *ac;
+		NMConnection *active = NULL;
+
+		if (!NM_IS_DEVICE_WIFI (device))
+			continue;
+
+		connections = nm_device_filter_connections (device, all_connections);
+		ac = nm_device_get_active_connection (device);
+		if (ac)
+			active = NM_CONNECTION (nm_active_connection_get_connection (ac));
+
+		for (j = 0; j < iterations; j++) {
+			GtkWidget *menu = g_object_ref_sink (gtk_menu_new ());
+			gint64 start = g_get_monotonic_time ();
+			gint64 elapsed;
+
+			applet->wifi_class->add_menu_item (device, n_wifi > 1, connections, active, menu, applet);
+			elapsed = g_get_monotonic_time () - start;
+			g_array_append_val (samples, elapsed);
+
+			gtk_widget_destroy (menu);
+			g_object_unref (menu);
+		}
+	}
+
+	g_ptr_array_unref (all_connections);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GApplication *app;
+	NMApplet *applet;
+	GError *error = NULL;
+	GArray *samples;
+	gint64 deadline;
+	guint iterations = 100;
+	const GPtrArray *devices;
+
+	gtk_init (&argc, &argv);
+
+	if (argc > 1)
+		iterations = MAX (1, atoi (argv[1]));
+
+	app = g_object_new (NM_TYPE_APPLET,
+	                    "application-id", "org.freedesktop.network-manager-applet.Benchmark",
+	                    "flags", G_APPLICATION_NON_UNIQUE,
+	                    NULL);
+	applet = NM_APPLET (app);
+	if (!g_application_register (app, NULL, &error)) {
+		g_printerr ("Could not register the applet: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	/* Wait for the client to pick up the mock service's objects, then give
+	 * the applet a while to finish processing them. */
+	g_timeout_add (100, wakeup_cb, NULL);
+	deadline = g_get_monotonic_time () + 30 * G_USEC_PER_SEC;
+	while (!client_ready (applet)) {
+		if (g_get_monotonic_time () > deadline) {
+			g_printerr ("Timed out waiting for NetworkManager\n");
+			return EXIT_FAILURE;
+		}
+		g_main_context_iteration (NULL, TRUE);
+	}
+	settle (500);
+
+	devices = nm_client_get_devices (applet->nm_client);
+	g_print ("scenario: devices=%u connections=%u iterations=%u\n",
+	         devices->len, nm_client_get_connections (applet->nm_client)->len, iterations);
+
+	samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+	bench_update_menu (applet, iterations, samples);
+	report ("applet_update_menu", samples);
+
+	g_array_set_size (samples, 0);
+	bench_wifi_add_menu_item (applet, iterations, samples);
+	report ("wifi_add_menu_item", samples);
+
+	g_array_unref (samples);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright 2026 Red Hat, Inc.
+#
+# Startup benchmark: starts the applet against the stand-in NetworkManager
+# from mock-nm-service.py a number of times and reports how long it took
+# until the devices were set up, and the resident set size once the applet
+# has settled:
+#
+#   run-with-mock-nm.py -- bench-startup.py [--runs N] -- nm-applet --no-agent
+#
+# The time is the applet's "time-to-initial-state-us" statistic; applets
+# that predate it only have "time-to-client-ready-us", which is reported
+# in its place.  Each run is printed as a JSON line, followed by one with
+# the medians.
+
+import argparse
+import json
+import statistics
+import sys
+import time
+
+from nmatest import Applet, split_command
+
+
+def wait_initial_state(applet, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        stats = applet.statistics()
+        if stats.get('time-to-initial-state-us', 0) >= 0:
+            return stats
+        time.sleep(0.05)
+    sys.exit('Timed out waiting for the applet to set up its devices')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the applet startup cost')
+    parser.add_argument('--runs', type=int, default=10, help='number of applet starts')
+    parser.add_argument('--settle', type=float, default=2, help='seconds to wait before sampling the RSS')
+    parser.add_argument('command', nargs=argparse.REMAINDER, help='the applet command line')
+    args = parser.parse_args()
+
+    command = split_command(parser, args)
+
+    runs = []
+    for run in range(1, args.runs + 1):
+        with Applet(command) as applet:
+            stats = wait_initial_state(applet, 30)
+            applet.settle(args.settle)
+            result = {
+                'run': run,
+                'startup-us': stats.get('time-to-initial-state-us',
+                                        stats['time-to-client-ready-us']),
+                'rss-kb': applet.rss_kb(),
+            }
+        print(json.dumps(result, sort_keys=True), flush=True)
+        runs.append(result)
+
+    print(json.dumps({
+        'median-startup-us': statistics.median(r['startup-us'] for r in runs),
+        'median-rss-kb': statistics.median(r['rss-kb'] for r in runs),
+    }, sort_keys=True))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,614 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright 2026 Red Hat, Inc.
+#
+# A minimal stand-in for the NetworkManager D-Bus service, good enough for
+# NMClient to build its object cache from.  It is meant to be run on a private
+# bus (see run-with-mock-nm.py) and seeded from the command line; the
+# org.freedesktop.NetworkManager.NmaTest interface on
+# /org/freedesktop/NetworkManager/NmaTest lets test drivers change the state
+# while the applet is running.
+
+import argparse
+import sys
+
+from gi.repository import Gio, GLib
+
+NM_NAME = 'org.freedesktop.NetworkManager'
+NM_PATH = '/org/freedesktop/NetworkManager'
+NM_IFACE = 'org.freedesktop.NetworkManager'
+SETTINGS_PATH = NM_PATH + '/Settings'
+SETTINGS_IFACE = NM_IFACE + '.Settings'
+CONNECTION_IFACE = SETTINGS_IFACE + '.Connection'
+DEVICE_IFACE = NM_IFACE + '.Device'
+WIRED_IFACE = DEVICE_IFACE + '.Wired'
+WIRELESS_IFACE = DEVICE_IFACE + '.Wireless'
+AP_IFACE = NM_IFACE + '.AccessPoint'
+ACTIVE_IFACE = NM_IFACE + '.Connection.Active'
+VPN_IFACE = NM_IFACE + '.VPN.Connection'
+TEST_PATH = NM_PATH + '/NmaTest'
+TEST_IFACE = NM_IFACE + '.NmaTest'
+OBJECT_MANAGER_PATH = '/org/freedesktop'
+OBJECT_MANAGER_IFACE = 'org.freedesktop.DBus.ObjectManager'
+PROPERTIES_IFACE = 'org.freedesktop.DBus.Properties'
+
+NM_STATE_DISCONNECTED = 20
+NM_STATE_CONNECTED_GLOBAL = 70
+NM_DEVICE_TYPE_ETHERNET = 1
+NM_DEVICE_TYPE_WIFI = 2
+NM_DEVICE_STATE_DISCONNECTED = 30
+NM_DEVICE_STATE_ACTIVATED = 100
+NM_ACTIVE_CONNECTION_STATE_ACTIVATED = 2
+NM_VPN_CONNECTION_STATE_ACTIVATED = 5
+NM_802_11_MODE_INFRA = 2
+NM_802_11_AP_SEC_KEY_MGMT_PSK = 0x100
+
+# Property signatures, per interface.  Only properties listed here are exported.
+PROPERTIES = {
+    NM_IFACE: {
+        'Devices': 'ao', 'AllDevices': 'ao', 'Checkpoints': 'ao',
+        'NetworkingEnabled': 'b', 'WirelessEnabled': 'b',
+        'WirelessHardwareEnabled': 'b', 'WwanEnabled': 'b',
+        'WwanHardwareEnabled': 'b', 'ActiveConnections': 'ao',
+        'PrimaryConnection': 'o', 'PrimaryConnectionType': 's',
+        'ActivatingConnection': 'o', 'Startup': 'b', 'Version': 's',
+        'State': 'u', 'Connectivity': 'u', 'Metered': 'u',
+    },
+    SETTINGS_IFACE: {
+        'Connections': 'ao', 'Hostname': 's', 'CanModify': 'b',
+    },
+    CONNECTION_IFACE: {
+        'Unsaved': 'b', 'Flags': 'u', 'Filename': 's',
+    },
+    DEVICE_IFACE: {
+        'Udi': 's', 'Interface': 's', 'IpInterface': 's', 'Driver': 's',
+        'Capabilities': 'u', 'State': 'u', 'StateReason': '(uu)',
+        'ActiveConnection': 'o', 'Ip4Config': 'o', 'Dhcp4Config': 'o',
+        'Ip6Config': 'o', 'Dhcp6Config': 'o', 'Managed': 'b',
+        'Autoconnect': 'b', 'FirmwareMissing': 'b', 'NmPluginMissing': 'b',
+        'DeviceType': 'u', 'AvailableConnections': 'ao', 'Mtu': 'u',
+        'Real': 'b', 'HwAddress': 's',
+    },
+    WIRED_IFACE: {
+        'HwAddress': 's', 'PermHwAddress': 's', 'Speed': 'u', 'Carrier': 'b',
+    },
+    WIRELESS_IFACE: {
+        'HwAddress': 's', 'PermHwAddress': 's', 'Mode': 'u', 'Bitrate': 'u',
+        'AccessPoints': 'ao', 'ActiveAccessPoint': 'o',
+        'WirelessCapabilities': 'u', 'LastScan': 'x',
+    },
+    AP_IFACE: {
+        'Flags': 'u', 'WpaFlags': 'u', 'RsnFlags': 'u', 'Ssid': 'ay',
+        'Frequency': 'u', 'HwAddress': 's', 'Mode': 'u', 'MaxBitrate': 'u',
+        'Strength': 'y', 'LastSeen': 'i',
+    },
+    ACTIVE_IFACE: {
+        'Connection': 'o', 'SpecificObject': 'o', 'Id': 's', 'Uuid': 's',
+        'Type': 's', 'Devices': 'ao', 'State': 'u', 'StateFlags': 'u',
+        'Default': 'b', 'Default6': 'b', 'Vpn': 'b', 'Master': 'o',
+        'Ip4Config': 'o', 'Ip6Config': 'o', 'Dhcp4Config': 'o',
+        'Dhcp6Config': 'o',
+    },
+    VPN_IFACE: {
+        'VpnState': 'u', 'Banner': 's',
+    },
+}
+
+METHODS = {
+    NM_IFACE: '''
+        <method name='GetPermissions'><arg direction='out' type='a{ss}'/></method>
+        <method name='GetDevices'><arg direction='out' type='ao'/></method>
+        <method name='GetAllDevices'><arg direction='out' type='ao'/></method>
+        <method name='state'><arg direction='out' type='u'/></method>
+        <signal name='StateChanged'><arg type='u'/></signal>
+        <signal name='DeviceAdded'><arg type='o'/></signal>
+        <signal name='DeviceRemoved'><arg type='o'/></signal>
+    ''',
+    SETTINGS_IFACE: '''
+        <method name='ListConnections'><arg direction='out' type='ao'/></method>
+        <method name='AddConnection'>
+          <arg direction='in' type='a{sa{sv}}'/><arg direction='out' type='o'/>
+        </method>
+        <method name='AddConnectionUnsaved'>
+          <arg direction='in' type='a{sa{sv}}'/><arg direction='out' type='o'/>
+        </method>
+        <signal name='NewConnection'><arg type='o'/></signal>
+        <signal name='ConnectionRemoved'><arg type='o'/></signal>
+    ''',
+    CONNECTION_IFACE: '''
+        <method name='GetSettings'><arg direction='out' type='a{sa{sv}}'/></method>
+        <method name='GetSecrets'>
+          <arg direction='in' type='s'/><arg direction='out' type='a{sa{sv}}'/>
+        </method>
+        <method name='Update'><arg direction='in' type='a{sa{sv}}'/></method>
+        <method name='Delete'/>
+        <signal name='Updated'/>
+        <signal name='Removed'/>
+    ''',
+    DEVICE_IFACE: '''
+        <signal name='StateChanged'><arg type='u'/><arg type='u'/><arg type='u'/></signal>
+    ''',
+    WIRELESS_IFACE: '''
+        <method name='GetAccessPoints'><arg direction='out' type='ao'/></method>
+        <method name='GetAllAccessPoints'><arg direction='out' type='ao'/></method>
+        <method name='RequestScan'><arg direction='in' type='a{sv}'/></method>
+        <signal name='AccessPointAdded'><arg type='o'/></signal>
+        <signal name='AccessPointRemoved'><arg type='o'/></signal>
+    ''',
+    TEST_IFACE: '''
+        <method name='AddWiredDevice'>
+          <arg direction='in' type='s' name='iface'/><arg direction='out' type='o'/>
+        </method>
+        <method name='AddWifiDevice'>
+          <arg direction='in' type='s' name='iface'/><arg direction='out' type='o'/>
+        </method>
+        <method name='RemoveDevice'><arg direction='in' type='o' name='device'/></method>
+        <method name='SetDeviceState'>
+          <arg direction='in' type='o' name='device'/><arg direction='in' type='u' name='state'/>
+        </method>
+        <method name='AddAccessPoint'>
+          <arg direction='in' type='o' name='device'/><arg direction='in' type='s' name='ssid'/>
+          <arg direction='in' type='y' name='strength'/><arg direction='out' type='o'/>
+        </method>
+        <method name='RemoveAccessPoint'>
+          <arg direction='in' type='o' name='device'/><arg direction='in' type='o' name='ap'/>
+        </method>
+        <method name='SetAccessPointStrength'>
+          <arg direction='in' type='o' name='ap'/><arg direction='in' type='y' name='strength'/>
+        </method>
+        <method name='AddWifiConnection'>
+          <arg direction='in' type='s' name='ssid'/><arg direction='out' type='o'/>
+        </method>
+        <method name='AddWiredConnection'>
+          <arg direction='in' type='s' name='id'/><arg direction='out' type='o'/>
+        </method>
+        <method name='AddVpnConnection'>
+          <arg direction='in' type='s' name='id'/><arg direction='out' type='o'/>
+        </method>
+        <method name='RemoveConnection'><arg direction='in' type='o' name='connection'/></method>
+        <method name='Activate'>
+          <arg direction='in' type='o' name='connection'/><arg direction='in' type='o' name='device'/>
+          <arg direction='out' type='o'/>
+        </method>
+        <method name='Deactivate'><arg direction='in' type='o' name='active'/></method>
+        <method name='GetDevices'><arg direction='out' type='ao'/></method>
+        <method name='GetAccessPoints'>
+          <arg direction='in' type='o' name='device'/><arg direction='out' type='ao'/>
+        </method>
+        <method name='GetConnections'><arg direction='out' type='ao'/></method>
+    ''',
+    OBJECT_MANAGER_IFACE: '''
+        <method name='GetManagedObjects'><arg direction='out' type='a{oa{sa{sv}}}'/></method>
+        <signal name='InterfacesAdded'><arg type='o'/><arg type='a{sa{sv}}'/></signal>
+        <signal name='InterfacesRemoved'><arg type='o'/><arg type='as'/></signal>
+    ''',
+}
+
+
+def interface_info(name):
+    props = ''.join("<property name='%s' type='%s' access='read'/>" % (p, t)
+                    for p, t in PROPERTIES.get(name, {}).items())
+    xml = "<node><interface name='%s'>%s%s</interface></node>" % (name, METHODS.get(name, ''), props)
+    return Gio.DBusNodeInfo.new_for_xml(xml).interfaces[0]
+
+
+INTERFACE_INFOS = {}
+
+
+def settings_from_variant(variant):
+    # Keep the a{sv} values as variants; unpack() would lose their types
+    settings = {}
+    for i in range(variant.n_children()):
+        entry = variant.get_child_value(i)
+        values = entry.get_child_value(1)
+        settings[entry.get_child_value(0).get_string()] = {
+            values.get_child_value(j).get_child_value(0).get_string():
+                values.get_child_value(j).get_child_value(1).get_variant()
+            for j in range(values.n_children())
+        }
+    return settings
+
+
+def get_interface_info(name):
+    if name not in INTERFACE_INFOS:
+        INTERFACE_INFOS[name] = interface_info(name)
+    return INTERFACE_INFOS[name]
+
+
+class DBusObject:
+    def __init__(self, service, path, props):
+        self.service = service
+        self.path = path
+        self.props = props
+        self.registration_ids = []
+
+    def variant(self, iface, name):
+        return GLib.Variant(PROPERTIES[iface][name], self.props[iface][name])
+
+    def interface_dict(self):
+        return {iface: {name: self.variant(iface, name) for name in values}
+                for iface, values in self.props.items()}
+
+    def export(self):
+        conn = self.service.connection
+        for iface in self.props:
+            self.registration_ids.append(
+                conn.register_object(self.path, get_interface_info(iface),
+                                     self.service.method_call,
+                                     self.get_property, None))
+
+    def unexport(self):
+        for registration_id in self.registration_ids:
+            self.service.connection.unregister_object(registration_id)
+        self.registration_ids = []
+
+    def get_property(self, connection, sender, path, iface, name):
+        return self.variant(iface, name)
+
+    def set(self, iface, **changes):
+        self.props[iface].update(changes)
+        changed = {name: self.variant(iface, name) for name in changes}
+        self.service.emit(self.path, PROPERTIES_IFACE, 'PropertiesChanged',
+                          GLib.Variant('(sa{sv}as)', (iface, changed, [])))
+
+
+class Service:
+    def __init__(self, args):
+        self.args = args
+        self.connection = None
+        self.objects = {}
+        self.counters = {}
+        self.manager = None
+        self.settings = None
+
+    def next_path(self, kind):
+        self.counters[kind] = self.counters.get(kind, 0) + 1
+        return '%s/%s/%d' % (NM_PATH, kind, self.counters[kind])
+
+    def emit(self, path, iface, signal, params):
+        # Nothing to tell anyone about while seeding the initial state
+        if self.connection:
+            self.connection.emit_signal(None, path, iface, signal, params)
+
+    def add_object(self, obj):
+        self.objects[obj.path] = obj
+        if self.connection:
+            obj.export()
+            self.emit(OBJECT_MANAGER_PATH, OBJECT_MANAGER_IFACE, 'InterfacesAdded',
+                      GLib.Variant('(oa{sa{sv}})', (obj.path, obj.interface_dict())))
+        return obj
+
+    def remove_object(self, path):
+        obj = self.objects.pop(path)
+        obj.unexport()
+        self.emit(OBJECT_MANAGER_PATH, OBJECT_MANAGER_IFACE, 'InterfacesRemoved',
+                  GLib.Variant('(oas)', (path, list(obj.props.keys()))))
+        return obj
+
+    # Object factories
+
+    def setup(self):
+        self.manager = DBusObject(self, NM_PATH, {NM_IFACE: {
+            'Devices': [], 'AllDevices': [], 'Checkpoints': [],
+            'NetworkingEnabled': True, 'WirelessEnabled': True,
+            'WirelessHardwareEnabled': True, 'WwanEnabled': True,
+            'WwanHardwareEnabled': True, 'ActiveConnections': [],
+            'PrimaryConnection': '/', 'PrimaryConnectionType': '',
+            'ActivatingConnection': '/', 'Startup': False,
+            'Version': '1.30.0', 'State': NM_STATE_DISCONNECTED,
+            'Connectivity': 1, 'Metered': 0,
+        }})
+        self.objects[NM_PATH] = self.manager
+        self.settings = DBusObject(self, SETTINGS_PATH, {SETTINGS_IFACE: {
+            'Connections': [], 'Hostname': 'mock', 'CanModify': True,
+        }})
+        self.objects[SETTINGS_PATH] = self.settings
+
+        for i in range(self.args.ethernet):
+            self.add_device('eth%d' % i, NM_DEVICE_TYPE_ETHERNET)
+        for i in range(self.args.wifi):
+            device = self.add_device('wlan%d' % i, NM_DEVICE_TYPE_WIFI)
+            for j in range(self.args.aps):
+                self.add_access_point(device, 'network-%d' % j, 20 + (j * 7) % 80)
+        for i in range(self.args.connections):
+            if i % 2 or not self.args.aps:
+                self.add_connection(self.ethernet_settings('Wired %d' % i))
+            else:
+                ssid = 'network-%d' % ((i // 2) % self.args.aps)
+                self.add_connection(self.wifi_settings(ssid))
+        for i in range(self.args.vpns):
+            self.add_connection(self.vpn_settings('VPN %d' % i))
+
+    def add_device(self, iface, device_type):
+        path = self.next_path('Devices')
+        hwaddr = '02:00:00:00:%02x:%02x' % (self.counters['Devices'] >> 8,
+                                            self.counters['Devices'] & 0xff)
+        props = {DEVICE_IFACE: {
+            'Udi': '/sys/devices/virtual/net/' + iface, 'Interface': iface,
+            'IpInterface': '', 'Driver': 'mock', 'Capabilities': 3,
+            'State': NM_DEVICE_STATE_DISCONNECTED,
+            'StateReason': (NM_DEVICE_STATE_DISCONNECTED, 0),
+            'ActiveConnection': '/', 'Ip4Config': '/', 'Dhcp4Config': '/',
+            'Ip6Config': '/', 'Dhcp6Config': '/', 'Managed': True,
+            'Autoconnect': True, 'FirmwareMissing': False,
+            'NmPluginMissing': False, 'DeviceType': device_type,
+            'AvailableConnections': [], 'Mtu': 1500, 'Real': True,
+            'HwAddress': hwaddr,
+        }}
+        if device_type == NM_DEVICE_TYPE_WIFI:
+            props[WIRELESS_IFACE] = {
+                'HwAddress': hwaddr, 'PermHwAddress': hwaddr,
+                'Mode': NM_802_11_MODE_INFRA, 'Bitrate': 0,
+                'AccessPoints': [], 'ActiveAccessPoint': '/',
+                'WirelessCapabilities': 0x3ff, 'LastScan': -1,
+            }
+        else:
+            props[WIRED_IFACE] = {
+                'HwAddress': hwaddr, 'PermHwAddress': hwaddr,
+                'Speed': 1000, 'Carrier': True,
+            }
+        device = self.add_object(DBusObject(self, path, props))
+        devices = self.manager.props[NM_IFACE]['Devices'] + [path]
+        self.manager.set(NM_IFACE, Devices=devices, AllDevices=devices)
+        self.emit(NM_PATH, NM_IFACE, 'DeviceAdded', GLib.Variant('(o)', (path,)))
+        return device
+
+    def remove_device(self, path):
+        device = self.objects[path]
+        if WIRELESS_IFACE in device.props:
+            for ap in list(device.props[WIRELESS_IFACE]['AccessPoints']):
+                self.remove_access_point(device, ap)
+        devices = [d for d in self.manager.props[NM_IFACE]['Devices'] if d != path]
+        self.manager.set(NM_IFACE, Devices=devices, AllDevices=devices)
+        self.emit(NM_PATH, NM_IFACE, 'DeviceRemoved', GLib.Variant('(o)', (path,)))
+        self.remove_object(path)
+
+    def set_device_state(self, device, state):
+        old = device.props[DEVICE_IFACE]['State']
+        device.set(DEVICE_IFACE, State=state, StateReason=(state, 0))
+        self.emit(device.path, DEVICE_IFACE, 'StateChanged',
+                  GLib.Variant('(uuu)', (state, old, 0)))
+
+    def add_access_point(self, device, ssid, strength):
+        path = self.next_path('AccessPoint')
+        n = self.counters['AccessPoint']
+        self.add_object(DBusObject(self, path, {AP_IFACE: {
+            'Flags': 1, 'WpaFlags': 0, 'RsnFlags': NM_802_11_AP_SEC_KEY_MGMT_PSK | 0x8 | 0x80,
+            'Ssid': list(ssid.encode('utf-8')), 'Frequency': 2412 + 5 * (n % 13),
+            'HwAddress': '02:10:%02x:%02x:%02x:%02x' % ((n >> 24) & 0xff, (n >> 16) & 0xff,
+                                                        (n >> 8) & 0xff, n & 0xff),
+            'Mode': NM_802_11_MODE_INFRA, 'MaxBitrate': 54000,
+            'Strength': strength, 'LastSeen': 1,
+        }}))
+        aps = device.props[WIRELESS_IFACE]['AccessPoints'] + [path]
+        device.set(WIRELESS_IFACE, AccessPoints=aps)
+        self.emit(device.path, WIRELESS_IFACE, 'AccessPointAdded', GLib.Variant('(o)', (path,)))
+        return path
+
+    def remove_access_point(self, device, path):
+        aps = [ap for ap in device.props[WIRELESS_IFACE]['AccessPoints'] if ap != path]
+        device.set(WIRELESS_IFACE, AccessPoints=aps)
+        self.emit(device.path, WIRELESS_IFACE, 'AccessPointRemoved', GLib.Variant('(o)', (path,)))
+        self.remove_object(path)
+
+    def connection_settings(self, name, ctype):
+        n = self.counters.get('Settings', 0) + 1
+        return {'connection': {
+            'id': GLib.Variant('s', name),
+            'uuid': GLib.Variant('s', '00000000-0000-4000-8000-%012x' % n),
+            'type': GLib.Variant('s', ctype),
+        }}
+
+    def ethernet_settings(self, name):
+        settings = self.connection_settings(name, '802-3-ethernet')
+        settings['802-3-ethernet'] = {}
+        return settings
+
+    def wifi_settings(self, ssid):
+        settings = self.connection_settings(ssid, '802-11-wireless')
+        settings['802-11-wireless'] = {
+            'ssid': GLib.Variant('ay', list(ssid.encode('utf-8'))),
+            'mode': GLib.Variant('s', 'infrastructure'),
+        }
+        settings['802-11-wireless-security'] = {
+            'key-mgmt': GLib.Variant('s', 'wpa-psk'),
+        }
+        return settings
+
+    def vpn_settings(self, name):
+        settings = self.connection_settings(name, 'vpn')
+        settings['vpn'] = {
+            'service-type': GLib.Variant('s', 'org.freedesktop.NetworkManager.openvpn'),
+            'data': GLib.Variant('a{ss}', {'remote': 'vpn.example.com'}),
+        }
+        return settings
+
+    def add_connection(self, settings):
+        path = '%s/%d' % (SETTINGS_PATH, self.counters.get('Settings', 0) + 1)
+        self.counters['Settings'] = self.counters.get('Settings', 0) + 1
+        obj = DBusObject(self, path, {CONNECTION_IFACE: {
+            'Unsaved': False, 'Flags': 0, 'Filename': '',
+        }})
+        obj.settings = settings
+        self.add_object(obj)
+        connections = self.settings.props[SETTINGS_IFACE]['Connections'] + [path]
+        self.settings.set(SETTINGS_IFACE, Connections=connections)
+        self.emit(SETTINGS_PATH, SETTINGS_IFACE, 'NewConnection', GLib.Variant('(o)', (path,)))
+        return path
+
+    def remove_connection(self, path):
+        connections = [c for c in self.settings.props[SETTINGS_IFACE]['Connections'] if c != path]
+        self.settings.set(SETTINGS_IFACE, Connections=connections)
+        self.emit(path, CONNECTION_IFACE, 'Removed', None)
+        self.emit(SETTINGS_PATH, SETTINGS_IFACE, 'ConnectionRemoved', GLib.Variant('(o)', (path,)))
+        self.remove_object(path)
+
+    def activate(self, connection_path, device_path):
+        connection = self.objects[connection_path]
+        s_con = connection.settings['connection']
+        vpn = s_con['type'].get_string() == 'vpn'
+        path = self.next_path('ActiveConnection')
+        props = {ACTIVE_IFACE: {
+            'Connection': connection_path, 'SpecificObject': '/',
+            'Id': s_con['id'].get_string(), 'Uuid': s_con['uuid'].get_string(),
+            'Type': s_con['type'].get_string(),
+            'Devices': [device_path] if device_path != '/' else [],
+            'State': NM_ACTIVE_CONNECTION_STATE_ACTIVATED, 'StateFlags': 0,
+            'Default': not vpn, 'Default6': False, 'Vpn': vpn, 'Master': '/',
+            'Ip4Config': '/', 'Ip6Config': '/', 'Dhcp4Config': '/',
+            'Dhcp6Config': '/',
+        }}
+        if vpn:
+            props[VPN_IFACE] = {'VpnState': NM_VPN_CONNECTION_STATE_ACTIVATED, 'Banner': ''}
+        self.add_object(DBusObject(self, path, props))
+        if device_path != '/':
+            device = self.objects[device_path]
+            device.set(DEVICE_IFACE, ActiveConnection=path)
+            self.set_device_state(device, NM_DEVICE_STATE_ACTIVATED)
+        active = self.manager.props[NM_IFACE]['ActiveConnections'] + [path]
+        self.manager.set(NM_IFACE, ActiveConnections=active, State=NM_STATE_CONNECTED_GLOBAL)
+        return path
+
+    def deactivate(self, path):
+        active = self.objects[path]
+        for device_path in active.props[ACTIVE_IFACE]['Devices']:
+            device = self.objects[device_path]
+            device.set(DEVICE_IFACE, ActiveConnection='/')
+            self.set_device_state(device, NM_DEVICE_STATE_DISCONNECTED)
+        remaining = [a for a in self.manager.props[NM_IFACE]['ActiveConnections'] if a != path]
+        self.manager.set(NM_IFACE, ActiveConnections=remaining,
+                         State=NM_STATE_CONNECTED_GLOBAL if remaining else NM_STATE_DISCONNECTED)
+        self.remove_object(path)
+
+    # D-Bus plumbing
+
+    def managed_objects(self):
+        return {path: obj.interface_dict() for path, obj in self.objects.items()}
+
+    def method_call(self, connection, sender, path, iface, method, params, invocation):
+        try:
+            result = self.dispatch(path, iface, method, params)
+        except KeyError as e:
+            invocation.return_dbus_error(NM_IFACE + '.Error.UnknownObject', 'No such object: %s' % e)
+            return
+        invocation.return_value(result)
+
+    def dispatch(self, path, iface, method, params):
+        obj = self.objects.get(path)
+        args = params.unpack()
+        if iface == OBJECT_MANAGER_IFACE:
+            return GLib.Variant('(a{oa{sa{sv}}})', (self.managed_objects(),))
+        if iface == NM_IFACE:
+            if method == 'GetPermissions':
+                return GLib.Variant('(a{ss})', ({},))
+            if method in ('GetDevices', 'GetAllDevices'):
+                return GLib.Variant('(ao)', (self.manager.props[NM_IFACE]['Devices'],))
+            if method == 'state':
+                return GLib.Variant('(u)', (self.manager.props[NM_IFACE]['State'],))
+        if iface == SETTINGS_IFACE:
+            if method == 'ListConnections':
+                return GLib.Variant('(ao)', (self.settings.props[SETTINGS_IFACE]['Connections'],))
+            if method in ('AddConnection', 'AddConnectionUnsaved'):
+                settings = settings_from_variant(params.get_child_value(0))
+                return GLib.Variant('(o)', (self.add_connection(settings),))
+        if iface == CONNECTION_IFACE:
+            if method == 'GetSettings':
+                return GLib.Variant('(a{sa{sv}})', (obj.settings,))
+            if method == 'GetSecrets':
+                return GLib.Variant('(a{sa{sv}})', ({},))
+            if method == 'Update':
+                obj.settings = settings_from_variant(params.get_child_value(0))
+                self.emit(path, CONNECTION_IFACE, 'Updated', None)
+                return None
+            if method == 'Delete':
+                self.remove_connection(path)
+                return None
+        if iface == WIRELESS_IFACE:
+            if method in ('GetAccessPoints', 'GetAllAccessPoints'):
+                return GLib.Variant('(ao)', (obj.props[WIRELESS_IFACE]['AccessPoints'],))
+            if method == 'RequestScan':
+                return None
+        if iface == TEST_IFACE:
+            return self.dispatch_test(method, args)
+        raise KeyError(path)
+
+    def dispatch_test(self, method, args):
+        if method == 'AddWiredDevice':
+            return GLib.Variant('(o)', (self.add_device(args[0], NM_DEVICE_TYPE_ETHERNET).path,))
+        if method == 'AddWifiDevice':
+            return GLib.Variant('(o)', (self.add_device(args[0], NM_DEVICE_TYPE_WIFI).path,))
+        if method == 'RemoveDevice':
+            self.remove_device(args[0])
+            return None
+        if method == 'SetDeviceState':
+            self.set_device_state(self.objects[args[0]], args[1])
+            return None
+        if method == 'AddAccessPoint':
+            return GLib.Variant('(o)', (self.add_access_point(self.objects[args[0]], args[1], args[2]),))
+        if method == 'RemoveAccessPoint':
+            self.remove_access_point(self.objects[args[0]], args[1])
+            return None
+        if method == 'SetAccessPointStrength':
+            self.objects[args[0]].set(AP_IFACE, Strength=args[1])
+            return None
+        if method == 'AddWifiConnection':
+            return GLib.Variant('(o)', (self.add_connection(self.wifi_settings(args[0])),))
+        if method == 'AddWiredConnection':
+            return GLib.Variant('(o)', (self.add_connection(self.ethernet_settings(args[0])),))
+        if method == 'AddVpnConnection':
+            return GLib.Variant('(o)', (self.add_connection(self.vpn_settings(args[0])),))
+        if method == 'RemoveConnection':
+            self.remove_connection(args[0])
+            return None
+        if method == 'Activate':
+            return GLib.Variant('(o)', (self.activate(args[0], args[1]),))
+        if method == 'Deactivate':
+            self.deactivate(args[0])
+            return None
+        if method == 'GetDevices':
+            return GLib.Variant('(ao)', (self.manager.props[NM_IFACE]['Devices'],))
+        if method == 'GetAccessPoints':
+            return GLib.Variant('(ao)', (self.objects[args[0]].props[WIRELESS_IFACE]['AccessPoints'],))
+        if method == 'GetConnections':
+            return GLib.Variant('(ao)', (self.settings.props[SETTINGS_IFACE]['Connections'],))
+        raise KeyError(method)
+
+    def bus_acquired(self, connection, name):
+        self.connection = connection
+        connection.register_object(OBJECT_MANAGER_PATH, get_interface_info(OBJECT_MANAGER_IFACE),
+                                   self.method_call, None, None)
+        connection.register_object(TEST_PATH, get_interface_info(TEST_IFACE),
+                                   self.method_call, None, None)
+        for obj in self.objects.values():
+            obj.export()
+
+    def name_acquired(self, connection, name):
+        # Tell run-with-mock-nm.py that we're ready
+        print('READY', flush=True)
+
+    def name_lost(self, connection, name):
+        sys.exit('Could not acquire the %s name' % name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stand-in NetworkManager D-Bus service')
+    parser.add_argument('--ethernet', type=int, default=1, help='number of ethernet devices')
+    parser.add_argument('--wifi', type=int, default=1, help='number of Wi-Fi devices')
+    parser.add_argument('--aps', type=int, default=20, help='number of access points per Wi-Fi device')
+    parser.add_argument('--connections', type=int, default=10, help='number of saved connections')
+    parser.add_argument('--vpns', type=int, default=2, help='number of VPN connections')
+    parser.add_argument('--system', action='store_true', help='use the system bus instead of the session bus')
+    args = parser.parse_args()
+
+    service = Service(args)
+    service.setup()
+
+    Gio.bus_own_name(Gio.BusType.SYSTEM if args.system else Gio.BusType.SESSION,
+                     NM_NAME, Gio.BusNameOwnerFlags.NONE,
+                     service.bus_acquired, service.name_acquired, service.name_lost)
+    GLib.MainLoop().run()
+
+
+if __name__ == '__main__':
+    main()
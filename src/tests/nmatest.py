@@ -0,0 +1,129 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright 2026 Red Hat, Inc.
+#
+# Helpers shared by the test drivers that run the applet against the stand-in
+# NetworkManager from mock-nm-service.py (see run-with-mock-nm.py).
+
+import os
+import subprocess
+import sys
+import time
+
+try:
+    from gi.repository import Gio, GLib
+except ImportError:
+    print('SKIP: python3-gi is not available', file=sys.stderr)
+    sys.exit(77)
+
+NM_NAME = 'org.freedesktop.NetworkManager'
+TEST_PATH = '/org/freedesktop/NetworkManager/NmaTest'
+TEST_IFACE = 'org.freedesktop.NetworkManager.NmaTest'
+APPLET_NAME = 'org.freedesktop.network-manager-applet'
+APPLET_PATH = '/org/freedesktop/network_manager_applet'
+DEBUG_IFACE = APPLET_NAME + '.Debug'
+
+
+class MockNM:
+    '''The NmaTest control interface of mock-nm-service.py'''
+
+    def __init__(self):
+        self.bus = Gio.bus_get_sync(Gio.BusType.SYSTEM, None)
+
+    def call(self, method, signature=None, args=None):
+        params = GLib.Variant(signature, args) if signature else None
+        result = self.bus.call_sync(NM_NAME, TEST_PATH, TEST_IFACE, method, params,
+                                    None, Gio.DBusCallFlags.NONE, -1, None)
+        return result.unpack()[0] if result and result.n_children() else None
+
+    def reset(self):
+        for device in self.call('GetDevices'):
+            self.call('RemoveDevice', '(o)', (device,))
+        for connection in self.call('GetConnections'):
+            self.call('RemoveConnection', '(o)', (connection,))
+
+
+class Applet:
+    '''A running applet, with access to its Debug interface'''
+
+    def __init__(self, command, timeout=30):
+        self.bus = Gio.bus_get_sync(Gio.BusType.SESSION, None)
+        self.proc = subprocess.Popen(command)
+        try:
+            self.wait_ready(timeout)
+        except BaseException:
+            self.stop()
+            raise
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.stop()
+
+    def call(self, method):
+        result = self.bus.call_sync(APPLET_NAME, APPLET_PATH, DEBUG_IFACE, method, None,
+                                    None, Gio.DBusCallFlags.NONE, -1, None)
+        return result.unpack()[0] if result.n_children() else None
+
+    def statistics(self):
+        return self.call('GetStatistics')
+
+    def wait_ready(self, timeout):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            if self.proc.poll() is not None:
+                sys.exit('The applet exited with status %d' % self.proc.returncode)
+            try:
+                if self.statistics()['time-to-client-ready-us'] >= 0:
+                    return
+            except GLib.Error:
+                pass
+            time.sleep(0.1)
+        sys.exit('Timed out waiting for the applet')
+
+    def settle(self, seconds):
+        # Let the applet drain its idle handlers; any D-Bus round trip to it
+        # only returns once its main loop got around to it.
+        time.sleep(seconds)
+        self.statistics()
+
+    def stop(self):
+        if self.proc.poll() is None:
+            self.proc.terminate()
+            try:
+                self.proc.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+
+    def cpu_ms(self):
+        # utime and stime, in clock ticks, follow the parenthesized command name
+        with open('/proc/%d/stat' % self.proc.pid) as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) * 1000 / os.sysconf('SC_CLK_TCK')
+
+    def wakeups(self):
+        # Every voluntary context switch of any thread is a sleep, and so a wakeup
+        wakeups = 0
+        for tid in os.listdir('/proc/%d/task' % self.proc.pid):
+            with open('/proc/%d/task/%s/status' % (self.proc.pid, tid)) as f:
+                for line in f:
+                    if line.startswith('voluntary_ctxt_switches:'):
+                        wakeups += int(line.split()[1])
+        return wakeups
+
+    def rss_kb(self):
+        with open('/proc/%d/status' % self.proc.pid) as f:
+            for line in f:
+                if line.startswith('VmRSS:'):
+                    return int(line.split()[1])
+        return 0
+
+
+def split_command(parser, args):
+    command = args.command
+    if command and command[0] == '--':
+        command = command[1:]
+    if not command:
+        parser.error('no applet command given')
+    return command
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright 2026 Red Hat, Inc.
+#
+# Replays a recording made with "nm-applet --record=FILE" against the stand-in
+# NetworkManager from mock-nm-service.py and reports what it cost the applet:
+#
+#   run-with-mock-nm.py --mock-arg=--ethernet=0 --mock-arg=--wifi=0 \
+#       --mock-arg=--connections=0 --mock-arg=--vpns=0 -- \
+#       replay-nm-trace.py [--speed N] TRACE -- nm-applet --no-agent
+#
+# The state recorded up to the "snapshot-end" event is set up before the
+# applet is started; the remaining events are replayed with their recorded
+# timing, divided by --speed (0 replays as fast as possible).  The result is
+# printed as one JSON object.  With the --max-* options the replay doubles as
+# a regression test and fails if a limit is exceeded.
+
+import argparse
+import json
+import os
+import sys
+import time
+
+from nmatest import Applet, MockNM, split_command
+
+NM_DEVICE_TYPE_ETHERNET = 1
+NM_DEVICE_TYPE_WIFI = 2
+NM_DEVICE_STATE_DISCONNECTED = 30
+
+CONNECTION_FACTORIES = {
+    '802-3-ethernet': 'AddWiredConnection',
+    '802-11-wireless': 'AddWifiConnection',
+    'vpn': 'AddVpnConnection',
+}
+
+
+class Replay:
+    def __init__(self, mock):
+        self.call = mock.call
+        self.devices = {}
+        self.aps = {}
+        self.active = {}
+        self.connections = {}
+        self.skipped = 0
+
+    def device_added(self, event):
+        if event['device-type'] == NM_DEVICE_TYPE_WIFI:
+            method = 'AddWifiDevice'
+        elif event['device-type'] == NM_DEVICE_TYPE_ETHERNET:
+            method = 'AddWiredDevice'
+        else:
+            self.skipped += 1
+            return
+        path = self.call(method, '(s)', (event['iface'],))
+        self.devices[event['device']] = path
+        if event['state'] not in (0, NM_DEVICE_STATE_DISCONNECTED):
+            self.call('SetDeviceState', '(ou)', (path, event['state']))
+
+    def device_removed(self, event):
+        path = self.devices.pop(event['device'], None)
+        if path:
+            self.call('RemoveDevice', '(o)', (path,))
+            self.aps = {k: v for k, v in self.aps.items() if v[0] != path}
+
+    def state_changed(self, event):
+        path = self.devices.get(event['device'])
+        if path:
+            self.call('SetDeviceState', '(ou)', (path, event['state']))
+
+    def ap_added(self, event):
+        device = self.devices.get(event['device'])
+        if device:
+            path = self.call('AddAccessPoint', '(osy)',
+                             (device, event['ssid'], event['strength']))
+            self.aps[event['ap']] = (device, path)
+
+    def ap_removed(self, event):
+        device, path = self.aps.pop(event['ap'], (None, None))
+        if path:
+            self.call('RemoveAccessPoint', '(oo)', (device, path))
+
+    def strength(self, event):
+        device, path = self.aps.get(event['ap'], (None, None))
+        if path:
+            self.call('SetAccessPointStrength', '(oy)', (path, event['strength']))
+
+    def connection_for(self, active):
+        key = (active['type'], active['id'])
+        if key not in self.connections:
+            factory = CONNECTION_FACTORIES.get(active['type'])
+            if not factory:
+                return None
+            self.connections[key] = self.call(factory, '(s)', (active['id'],))
+        return self.connections[key]
+
+    def active_connections(self, event):
+        recorded = {active['path']: active for active in event['active']}
+        for path in [p for p in self.active if p not in recorded]:
+            self.call('Deactivate', '(o)', (self.active.pop(path),))
+        for path, active in recorded.items():
+            if path in self.active:
+                continue
+            connection = self.connection_for(active)
+            if not connection:
+                self.skipped += 1
+                continue
+            device = self.devices.get(active['device'], '/')
+            self.active[path] = self.call('Activate', '(oo)', (connection, device))
+
+    def apply(self, event):
+        handler = getattr(self, event['event'].replace('-', '_'), None)
+        if handler:
+            handler(event)
+        else:
+            self.skipped += 1
+
+
+def read_trace(filename):
+    with open(filename) as f:
+        events = [json.loads(line) for line in f if line.strip()]
+    for i, event in enumerate(events):
+        if event['event'] == 'snapshot-end':
+            return events[:i], events[i + 1:]
+    return [], events
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay a recorded NetworkManager trace')
+    parser.add_argument('--speed', type=float, default=1.0,
+                        help='replay speed factor, 0 for as fast as possible')
+    parser.add_argument('--settle', type=float, default=1.0,
+                        help='seconds to let the applet settle before and after the replay')
+    parser.add_argument('--max-cpu-ms', type=float, help='fail if the applet used more CPU time')
+    parser.add_argument('--max-wakeups', type=int, help='fail if the applet woke up more often')
+    parser.add_argument('--max-menu-updates', type=int, help='fail if the menu was rebuilt more often')
+    parser.add_argument('--max-icon-updates', type=int, help='fail if the icon was updated more often')
+    parser.add_argument('trace', help='recording made with nm-applet --record')
+    parser.add_argument('command', nargs=argparse.REMAINDER, help='the applet command line')
+    args = parser.parse_args()
+
+    command = split_command(parser, args)
+    snapshot, events = read_trace(args.trace)
+
+    mock = MockNM()
+    mock.reset()
+    replay = Replay(mock)
+    for event in snapshot:
+        replay.apply(event)
+
+    with Applet(command) as applet:
+        applet.settle(args.settle)
+        applet.call('Reset')
+        cpu_before, wakeups_before = applet.cpu_ms(), applet.wakeups()
+        start = time.monotonic()
+        base_us = events[0]['t_us'] if events else 0
+
+        for event in events:
+            if args.speed > 0:
+                delay = start + (event['t_us'] - base_us) / 1e6 / args.speed - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            replay.apply(event)
+
+        duration = time.monotonic() - start
+        applet.settle(args.settle)
+        cpu_after, wakeups_after = applet.cpu_ms(), applet.wakeups()
+        statistics = applet.statistics()
+
+    result = {
+        'trace': os.path.basename(args.trace),
+        'events': len(events),
+        'skipped': replay.skipped,
+        'speed': args.speed,
+        'duration_s': round(duration, 3),
+        'cpu_ms': round(cpu_after - cpu_before, 1),
+        'wakeups': wakeups_after - wakeups_before,
+        'menu_updates': statistics['menu-updates']['count'],
+        'icon_updates': statistics['icon-updates']['count'],
+    }
+    print(json.dumps(result, sort_keys=True))
+
+    failed = False
+    for key, limit in (('cpu_ms', args.max_cpu_ms), ('wakeups', args.max_wakeups),
+                       ('menu_updates', args.max_menu_updates),
+                       ('icon_updates', args.max_icon_updates)):
+        if limit is not None and result[key] > limit:
+            print('FAIL: %s is %s, the limit is %s' % (key, result[key], limit), file=sys.stderr)
+            failed = True
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright 2026 Red Hat, Inc.
+#
+# Runs a command against the stand-in NetworkManager service from
+# mock-nm-service.py:
+#
+#   run-with-mock-nm.py [--schema FILE] [--mock-arg=ARG ...] -- COMMAND [ARGS...]
+#
+# A private dbus-daemon serves as both the session and the system bus, the
+# applet's GSettings schema is compiled into a temporary directory and, if
+# there is no display, the command is run under Xvfb or broadwayd.  Exits with
+# 77 (the "skipped" exit code of meson and automake) if the environment can't
+# be set up.
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+SKIP = 77
+
+
+def skip(message):
+    print('SKIP: %s' % message, file=sys.stderr)
+    sys.exit(SKIP)
+
+
+def start_bus(env):
+    if not shutil.which('dbus-daemon'):
+        skip('dbus-daemon not found')
+    proc = subprocess.Popen(['dbus-daemon', '--session', '--nofork', '--print-address'],
+                            stdout=subprocess.PIPE, env=env, universal_newlines=True)
+    address = proc.stdout.readline().strip()
+    if not address:
+        skip('could not start dbus-daemon')
+    return proc, address
+
+
+def start_display(env, tmpdir):
+    if env.get('DISPLAY') or env.get('WAYLAND_DISPLAY'):
+        return None
+
+    if shutil.which('Xvfb'):
+        read_fd, write_fd = os.pipe()
+        proc = subprocess.Popen(['Xvfb', '-displayfd', str(write_fd), '-nolisten', 'tcp',
+                                 '-screen', '0', '1024x768x24'],
+                                pass_fds=[write_fd], env=env)
+        os.close(write_fd)
+        with os.fdopen(read_fd) as f:
+            display = f.readline().strip()
+        if not display:
+            skip('could not start Xvfb')
+        env['DISPLAY'] = ':' + display
+        env['GDK_BACKEND'] = 'x11'
+        return proc
+
+    if shutil.which('broadwayd'):
+        display = ':%d' % (os.getpid() % 1000 + 5)
+        proc = subprocess.Popen(['broadwayd', display], env=env,
+                                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        env['BROADWAY_DISPLAY'] = display
+        env['GDK_BACKEND'] = 'broadway'
+        return proc
+
+    skip('no display, and neither Xvfb nor broadwayd was found')
+
+
+def compile_schema(schema, env, tmpdir):
+    if not schema:
+        return
+    if not shutil.which('glib-compile-schemas'):
+        skip('glib-compile-schemas not found')
+    shutil.copy(schema, tmpdir)
+    subprocess.check_call(['glib-compile-schemas', tmpdir])
+    env['GSETTINGS_SCHEMA_DIR'] = tmpdir
+    env['GSETTINGS_BACKEND'] = 'memory'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run a command against a stand-in NetworkManager')
+    parser.add_argument('--schema', help='GSettings schema to compile and use')
+    parser.add_argument('--mock-arg', action='append', default=[],
+                        help='argument to pass on to mock-nm-service.py')
+    parser.add_argument('command', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    command = args.command
+    if command and command[0] == '--':
+        command = command[1:]
+    if not command:
+        parser.error('no command given')
+
+    mock = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'mock-nm-service.py')
+    env = dict(os.environ)
+    env['NO_AT_BRIDGE'] = '1'
+    env.pop('DBUS_SESSION_BUS_PID', None)
+
+    procs = []
+    with tempfile.TemporaryDirectory(prefix='nma-mock-') as tmpdir:
+        try:
+            compile_schema(args.schema, env, tmpdir)
+
+            bus, address = start_bus(env)
+            procs.append(bus)
+            env['DBUS_SESSION_BUS_ADDRESS'] = address
+            env['DBUS_SYSTEM_BUS_ADDRESS'] = address
+
+            service = subprocess.Popen([sys.executable, mock] + args.mock_arg,
+                                       stdout=subprocess.PIPE, env=env,
+                                       universal_newlines=True)
+            procs.append(service)
+            if service.stdout.readline().strip() != 'READY':
+                skip('the mock NetworkManager service failed to start')
+
+            display = start_display(env, tmpdir)
+            if display:
+                procs.append(display)
+
+            env['NMA_MOCK_NM_PID'] = str(service.pid)
+            returncode = subprocess.call(command, env=env)
+        finally:
+            for proc in reversed(procs):
+                proc.terminate()
+                try:
+                    proc.wait(timeout=5)
+                except subprocess.TimeoutExpired:
+                    proc.kill()
+
+    sys.exit(returncode)
+
+
+if __name__ == '__main__':
+    main()
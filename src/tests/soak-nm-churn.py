@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Copyright 2026 Red Hat, Inc.
+#
+# Soak test: churns access points and connections in the stand-in
+# NetworkManager from mock-nm-service.py and checks that the applet's memory
+# use stays bounded:
+#
+#   run-with-mock-nm.py -- soak-nm-churn.py [--cycles N] -- nm-applet --no-agent
+#
+# Every cycle makes --aps access points appear, change strength and disappear
+# again, and adds, activates, deactivates and removes a Wi-Fi connection
+# (every fifth cycle a VPN one too).  The resident set size and the number
+# of live GObjects are sampled along the way; after a warm-up, neither may
+# grow by more than the --max-* limits.  Samples are printed as JSON lines.
+
+import argparse
+import json
+import os
+import sys
+
+from nmatest import Applet, MockNM, split_command
+
+
+def churn(mock, wifi, cycle, n_aps):
+    aps = [mock.call('AddAccessPoint', '(osy)', (wifi, 'soak-%d' % i, 20 + (cycle + i) % 70))
+           for i in range(n_aps)]
+    for i, ap in enumerate(aps):
+        mock.call('SetAccessPointStrength', '(oy)', (ap, 90 - (cycle + i) % 70))
+    for ap in aps:
+        mock.call('RemoveAccessPoint', '(oo)', (wifi, ap))
+
+    connection = mock.call('AddWifiConnection', '(s)', ('soak-%d' % (cycle % n_aps),))
+    active = mock.call('Activate', '(oo)', (connection, wifi))
+    if cycle % 5 == 0:
+        vpn = mock.call('AddVpnConnection', '(s)', ('soak-vpn',))
+        vpn_active = mock.call('Activate', '(oo)', (vpn, '/'))
+        mock.call('Deactivate', '(o)', (vpn_active,))
+        mock.call('RemoveConnection', '(o)', (vpn,))
+    mock.call('Deactivate', '(o)', (active,))
+    mock.call('RemoveConnection', '(o)', (connection,))
+
+
+def sample(applet, cycle):
+    applet.settle(0.5)
+    statistics = applet.statistics()
+    result = {
+        'cycle': cycle,
+        'rss_kb': applet.rss_kb(),
+        'objects': statistics['object-count'],
+    }
+    print(json.dumps(result, sort_keys=True), flush=True)
+    return result, statistics['object-counts']
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Check the applet for memory growth under churn')
+    parser.add_argument('--cycles', type=int, default=2000, help='number of churn cycles')
+    parser.add_argument('--aps', type=int, default=10, help='access points per cycle')
+    parser.add_argument('--sample-every', type=int, default=100, help='cycles between samples')
+    parser.add_argument('--warmup', type=int, default=200, help='cycles before the baseline sample')
+    parser.add_argument('--max-rss-growth-kb', type=int, default=2048,
+                        help='allowed RSS growth after the warm-up')
+    parser.add_argument('--max-object-growth', type=int, default=100,
+                        help='allowed growth of the live GObject count after the warm-up')
+    parser.add_argument('command', nargs=argparse.REMAINDER, help='the applet command line')
+    args = parser.parse_args()
+
+    command = split_command(parser, args)
+
+    mock = MockNM()
+    mock.reset()
+    mock.call('AddWiredDevice', '(s)', ('eth0',))
+    wifi = mock.call('AddWifiDevice', '(s)', ('wlan0',))
+
+    # Needed for g_type_get_instance_count() and so the object counts
+    os.environ['GOBJECT_DEBUG'] = 'instance-count'
+
+    with Applet(command) as applet:
+        baseline = baseline_counts = None
+        for cycle in range(1, args.cycles + 1):
+            churn(mock, wifi, cycle, args.aps)
+            if cycle == args.warmup:
+                baseline, baseline_counts = sample(applet, cycle)
+            elif cycle % args.sample_every == 0:
+                sample(applet, cycle)
+        final, final_counts = sample(applet, args.cycles)
+
+    if not baseline:
+        sys.exit('--warmup must be less than --cycles')
+
+    failed = False
+    rss_growth = final['rss_kb'] - baseline['rss_kb']
+    if rss_growth > args.max_rss_growth_kb:
+        print('FAIL: RSS grew by %d kB' % rss_growth, file=sys.stderr)
+        failed = True
+
+    object_growth = final['objects'] - baseline['objects']
+    if not final['objects']:
+        print('GObject instance counting is not available, not checking object counts',
+              file=sys.stderr)
+    elif object_growth > args.max_object_growth:
+        print('FAIL: the number of live GObjects grew by %d' % object_growth, file=sys.stderr)
+        for name, count in sorted(final_counts.items()):
+            if count > baseline_counts.get(name, 0):
+                print('  %s: %d -> %d' % (name, baseline_counts.get(name, 0), count),
+                      file=sys.stderr)
+        failed = True
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
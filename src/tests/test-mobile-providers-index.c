@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+
+#include "mobile-providers-index.h"
+
+#include "nm-utils/nm-test-utils.h"
+
+static MobileProvidersIndex *
+build_index (const GStatBuf *source)
+{
+	static const char *const short_mnc[] = { "31041", NULL };
+	static const char *const long_mnc[] = { "310410", "310150", NULL };
+	static const char *const other[] = { "23415", "x2341", NULL };
+	static const guint32 sids[] = { 4, 8, 0 };
+	MobileProvidersIndexBuilder *builder;
+	gs_unref_bytes GBytes *bytes = NULL;
+	MobileProvidersIndex *index;
+
+	builder = mobile_providers_index_builder_new ();
+	mobile_providers_index_builder_add (builder, "Short", short_mnc, NULL);
+	mobile_providers_index_builder_add (builder, "Long", long_mnc, sids);
+	mobile_providers_index_builder_add (builder, "Other", other, sids);
+	bytes = mobile_providers_index_builder_end (builder, source);
+
+	index = mobile_providers_index_new (bytes, source);
+	g_assert (index);
+	return index;
+}
+
+static void
+test_3gpp (void)
+{
+	MobileProvidersIndex *index = build_index (NULL);
+
+	/* Whole codes are preferred */
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "31041"), ==, "Short");
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "310410"), ==, "Long");
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "23415"), ==, "Other");
+
+	/* A 6-digit code matches a 5-digit one with the same MCC and first
+	 * two MNC digits... */
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "310411"), ==, "Short");
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "234150"), ==, "Other");
+
+	/* ... and the other way around */
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "31015"), ==, "Long");
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "310159"), ==, "Long");
+
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "31042"), ==, NULL);
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "310420"), ==, NULL);
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "x2341"), ==, NULL);
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "3104100"), ==, NULL);
+
+	mobile_providers_index_free (index);
+}
+
+static void
+test_3gpp2 (void)
+{
+	MobileProvidersIndex *index = build_index (NULL);
+
+	/* The first provider added wins */
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp2 (index, 4), ==, "Long");
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp2 (index, 8), ==, "Long");
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp2 (index, 5), ==, NULL);
+
+	mobile_providers_index_free (index);
+}
+
+static void
+test_invalid (void)
+{
+	MobileProvidersIndexBuilder *builder;
+	gs_unref_bytes GBytes *bytes = NULL;
+	gs_unref_bytes GBytes *truncated = NULL;
+	gs_unref_bytes GBytes *corrupt = NULL;
+	GStatBuf source = { }, changed;
+	MobileProvidersIndex *index;
+	guint8 *data;
+	gsize len;
+
+	source.st_mtime = 1000;
+	source.st_size = 2000;
+	changed = source;
+	changed.st_size++;
+
+	builder = mobile_providers_index_builder_new ();
+	bytes = mobile_providers_index_builder_end (builder, &source);
+
+	index = mobile_providers_index_new (bytes, &source);
+	g_assert (index);
+	g_assert_cmpstr (mobile_providers_index_lookup_3gpp (index, "31041"), ==, NULL);
+	mobile_providers_index_free (index);
+
+	g_assert (!mobile_providers_index_new (bytes, &changed));
+
+	truncated = g_bytes_new_from_bytes (bytes, 0, g_bytes_get_size (bytes) - 1);
+	g_assert (!mobile_providers_index_new (truncated, NULL));
+
+	data = g_bytes_unref_to_data (g_bytes_ref (bytes), &len);
+	data[0] ^= 0xff;
+	corrupt = g_bytes_new_take (data, len);
+	g_assert (!mobile_providers_index_new (corrupt, NULL));
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init (&argc, &argv, TRUE);
+
+	g_test_add_func ("/mobile-providers-index/3gpp", test_3gpp);
+	g_test_add_func ("/mobile-providers-index/3gpp2", test_3gpp2);
+	g_test_add_func ("/mobile-providers-index/invalid", test_invalid);
+
+	return g_test_run ();
+}
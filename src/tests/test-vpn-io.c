@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+#include "nm-default.h"
+
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "applet-vpn-io.h"
+
+#include "nm-utils/nm-test-utils.h"
+
+/* Stand-in auth dialogs */
+#define DIALOG_ECHO     "exec cat"
+#define DIALOG_SECRETS  "sed -n '/^QUIT$/q' >/dev/null; " \
+                        "awk 'BEGIN { for (i = 0; i < 50000; i++) printf \"secret%d\\n%0100d\\n\", i, i; printf \"\\n\\n\" }'"
+#define DIALOG_HANG     "exec sleep 60"
+#define DIALOG_EXIT     "exit 0"
+
+typedef struct {
+	GMainLoop *loop;
+	GString *output;
+	guint lines;
+	GError *error;
+} TestIo;
+
+static gboolean
+line_cb (const char *line, gsize len, gpointer user_data, GError **error)
+{
+	TestIo *t = user_data;
+
+	g_assert_cmpint (strlen (line), ==, len);
+	g_string_append_len (t->output, line, len);
+	g_string_append_c (t->output, '\n');
+	t->lines++;
+	return TRUE;
+}
+
+static void
+done_cb (GError *error, gpointer user_data)
+{
+	TestIo *t = user_data;
+
+	g_assert (!t->error);
+	if (error)
+		t->error = g_error_copy (error);
+	g_main_loop_quit (t->loop);
+}
+
+/* What a VPN connection with large data items looks like to the dialog */
+static GBytes *
+make_input (guint n_items)
+{
+	GString *str = g_string_new (NULL);
+	guint i;
+
+	for (i = 0; i < n_items; i++)
+		g_string_append_printf (str, "DATA_KEY=route%u\nDATA_VAL=%064u\n", i, i);
+	g_string_append (str, "DONE\n\nQUIT\n\n");
+	return g_string_free_to_bytes (str);
+}
+
+static void
+run_dialog (const char *script, GBytes *input, guint timeout_sec, TestIo *t)
+{
+	const char *argv[] = { "/bin/sh", "-c", script, NULL };
+	AppletVpnIo *io;
+	int child_stdin, child_stdout;
+	GError *error = NULL;
+	GPid pid;
+
+	g_spawn_async_with_pipes (NULL, (char **) argv, NULL,
+	                          G_SPAWN_DO_NOT_REAP_CHILD,
+	                          NULL, NULL, &pid,
+	                          &child_stdin, &child_stdout, NULL,
+	                          &error);
+	g_assert_no_error (error);
+
+	memset (t, 0, sizeof (*t));
+	t->loop = g_main_loop_new (NULL, FALSE);
+	t->output = g_string_new (NULL);
+
+	io = applet_vpn_io_new (child_stdin, child_stdout, input, timeout_sec,
+	                        line_cb, done_cb, t);
+	g_main_loop_run (t->loop);
+	applet_vpn_io_free (io);
+
+	kill (pid, SIGKILL);
+	waitpid (pid, NULL, 0);
+	g_main_loop_unref (t->loop);
+}
+
+static void
+test_io_clear (TestIo *t)
+{
+	g_string_free (t->output, TRUE);
+	g_clear_error (&t->error);
+}
+
+/*****************************************************************************/
+
+static void
+test_vpn_io_echo (void)
+{
+	gs_unref_bytes GBytes *input = make_input (40000);
+	gconstpointer data;
+	gsize len;
+	TestIo t;
+
+	/* Both pipes fill up unless writing and reading go on at once */
+	run_dialog (DIALOG_ECHO, input, 0, &t);
+	g_assert_no_error (t.error);
+
+	data = g_bytes_get_data (input, &len);
+	g_assert_cmpint (t.output->len, ==, len);
+	g_assert (memcmp (t.output->str, data, len) == 0);
+	g_assert_cmpint (t.lines, ==, 2 * 40000 + 4);
+	test_io_clear (&t);
+}
+
+static void
+test_vpn_io_secrets (void)
+{
+	gs_unref_bytes GBytes *input = make_input (40000);
+	gs_free char *last = g_strdup_printf ("secret49999\n%0100d\n\n\n", 49999);
+	TestIo t;
+
+	run_dialog (DIALOG_SECRETS, input, 0, &t);
+	g_assert_no_error (t.error);
+
+	g_assert_cmpint (t.lines, ==, 2 * 50000 + 2);
+	g_assert (g_str_has_prefix (t.output->str, "secret0\n"));
+	g_assert (g_str_has_suffix (t.output->str, last));
+	test_io_clear (&t);
+}
+
+static void
+test_vpn_io_timeout (void)
+{
+	gs_unref_bytes GBytes *input = make_input (10);
+	TestIo t;
+
+	run_dialog (DIALOG_HANG, input, 1, &t);
+	g_assert_error (t.error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+	g_assert_cmpint (t.lines, ==, 0);
+	test_io_clear (&t);
+}
+
+static void
+test_vpn_io_early_exit (void)
+{
+	gs_unref_bytes GBytes *input = make_input (40000);
+	TestIo t;
+
+	/* The rest of the input can't be written, but that's up to the dialog */
+	run_dialog (DIALOG_EXIT, input, 10, &t);
+	g_assert_no_error (t.error);
+	g_assert_cmpint (t.lines, ==, 0);
+	test_io_clear (&t);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init (&argc, &argv, TRUE);
+
+	/* As in nm-applet, writing to a closed pipe fails instead */
+	signal (SIGPIPE, SIG_IGN);
+
+	g_test_add_func ("/vpn-io/echo", test_vpn_io_echo);
+	g_test_add_func ("/vpn-io/secrets", test_vpn_io_secrets);
+	g_test_add_func ("/vpn-io/timeout", test_vpn_io_timeout);
+	g_test_add_func ("/vpn-io/early-exit", test_vpn_io_early_exit);
+
+	return g_test_run ();
+}
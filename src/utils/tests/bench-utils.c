@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-2.0+
+/* NetworkManager Applet -- allow user control over networking
+ *
+ * Copyright 2026 Red Hat, Inc.
+ */
+
+/* Throughput of the helpers in utils.c that run on interactive paths.
+ * Each benchmark prints one JSON object per line, so the output can be
+ * collected and compared over time.
+ */
+
+#include "nm-default.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "utils.h"
+
+#define ROUNDS 7
+#define N_SSIDS 10000
+#define N_BODIES 200
+#define N_KEYSTROKES 5000
+#define N_ROUTES 5000
+
+typedef void (*BenchFunc) (gpointer data, guint n_items);
+
+static int
+compare_int64 (const void *a, const void *b)
+{
+	gint64 x = *(const gint64 *) a;
+	gint64 y = *(const gint64 *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+bench_run (const char *name, BenchFunc func, gpointer data, guint n_items)
+{
+	gint64 times[ROUNDS];
+	double min_ns, median_ns;
+	int i;
+
+	/* warm up caches and lazily initialized state */
+	func (data, n_items);
+
+	for (i = 0; i < ROUNDS; i++) {
+		gint64 start = g_get_monotonic_time ();
+
+		func (data, n_items);
+		times[i] = g_get_monotonic_time () - start;
+	}
+
+	qsort (times, ROUNDS, sizeof (gint64), compare_int64);
+	min_ns = times[0] * 1000.0 / n_items;
+	median_ns = times[ROUNDS / 2] * 1000.0 / n_items;
+
+	g_print ("{\"benchmark\":\"%s\",\"items\":%u,\"rounds\":%d,"
+	         "\"min_ns_per_item\":%.1f,\"median_ns_per_item\":%.1f,\"items_per_sec\":%.0f}\n",
+	         name, n_items, ROUNDS, min_ns, median_ns,
+	         median_ns > 0 ? 1e9 / median_ns : 0.0);
+}
+
+/*****************************************************************************/
+
+typedef struct {
+	GBytes *ssid;
+	NM80211Mode mode;
+	guint32 flags;
+	guint32 wpa_flags;
+	guint32 rsn_flags;
+} ApData;
+
+static ApData *
+make_aps (GRand *rand, guint n)
+{
+	static const guint32 sec_flags[] = {
+		NM_802_11_AP_SEC_NONE,
+		NM_802_11_AP_SEC_PAIR_TKIP | NM_802_11_AP_SEC_GROUP_TKIP | NM_802_11_AP_SEC_KEY_MGMT_PSK,
+		NM_802_11_AP_SEC_PAIR_CCMP | NM_802_11_AP_SEC_GROUP_CCMP | NM_802_11_AP_SEC_KEY_MGMT_PSK,
+		NM_802_11_AP_SEC_PAIR_CCMP | NM_802_11_AP_SEC_GROUP_CCMP | NM_802_11_AP_SEC_KEY_MGMT_802_1X,
+	};
+	ApData *aps = g_new0 (ApData, n);
+	guint i, j;
+
+	for (i = 0; i < n; i++) {
+		guint len = g_rand_int_range (rand, 1, 33);
+		guint8 ssid[32];
+
+		for (j = 0; j < len; j++)
+			ssid[j] = g_rand_int_range (rand, ' ', '~' + 1);
+
+		aps[i].ssid = g_bytes_new (ssid, len);
+		aps[i].mode = (i % 10) ? NM_802_11_MODE_INFRA : NM_802_11_MODE_ADHOC;
+		aps[i].flags = (i % 4) ? NM_802_11_AP_FLAGS_PRIVACY : NM_802_11_AP_FLAGS_NONE;
+		aps[i].wpa_flags = sec_flags[i % G_N_ELEMENTS (sec_flags)];
+		aps[i].rsn_flags = sec_flags[(i / 2) % G_N_ELEMENTS (sec_flags)];
+	}
+
+	return aps;
+}
+
+static void
+bench_hash_ap (gpointer data, guint n_items)
+{
+	ApData *aps = data;
+	guint i;
+
+	for (i = 0; i < n_items; i++) {
+		g_free (utils_hash_ap (aps[i].ssid, aps[i].mode, aps[i].flags,
+		                       aps[i].wpa_flags, aps[i].rsn_flags));
+	}
+}
+
+/*****************************************************************************/
+
+static char **
+make_bodies (GRand *rand, guint n)
+{
+	static const char *fragments[] = {
+		"You are now connected to the Wi-Fi network ",
+		"<B>Home & Office</B>",
+		"<p>",
+		"</p>",
+		"<center>",
+		"</center>",
+		"<I>Connection Established</I>",
+		"<u>eth0</u>",
+		"The network connection has been disconnected. ",
+		"Signal strength & quality are good. ",
+		"<b>lowercase tags</b> are kept as they are. ",
+	};
+	char **bodies = g_new0 (char *, n + 1);
+	guint i;
+
+	for (i = 0; i < n; i++) {
+		GString *str = g_string_new (NULL);
+
+		while (str->len < 4096)
+			g_string_append (str, fragments[g_rand_int_range (rand, 0, G_N_ELEMENTS (fragments))]);
+		bodies[i] = g_string_free (str, FALSE);
+	}
+
+	return bodies;
+}
+
+static void
+bench_escape_notify_body (gpointer data, guint n_items)
+{
+	char **bodies = data;
+	guint i;
+
+	for (i = 0; i < n_items; i++)
+		g_free (utils_escape_notify_body (bodies[i]));
+}
+
+/*****************************************************************************/
+
+typedef struct {
+	GtkWidget *entry;
+	char **keystrokes;
+} FilterData;
+
+static void
+address_filter_cb (GtkEditable *editable,
+                   gchar *text,
+                   gint length,
+                   gint *position,
+                   gpointer user_data)
+{
+	utils_filter_editable_on_insert_text (editable,
+	                                      text, length, position, user_data,
+	                                      utils_char_is_ascii_ip6_address,
+	                                      address_filter_cb);
+}
+
+static char **
+make_keystrokes (GRand *rand, guint n)
+{
+	static const char typed[] = "0123456789abcdef:.xyz /";
+	char **keystrokes = g_new0 (char *, n + 1);
+	guint i;
+
+	for (i = 0; i < n; i++) {
+		/* mostly single characters, with an occasional paste */
+		if (i % 50 == 0)
+			keystrokes[i] = g_strdup ("fe80::1ff:fe23:4567:890a/64 ignored");
+		else
+			keystrokes[i] = g_strndup (&typed[g_rand_int_range (rand, 0, sizeof (typed) - 1)], 1);
+	}
+
+	return keystrokes;
+}
+
+static void
+bench_filter_editable (gpointer data, guint n_items)
+{
+	FilterData *d = data;
+	guint i;
+
+	gtk_entry_set_text (GTK_ENTRY (d->entry), "");
+
+	for (i = 0; i < n_items; i++) {
+		int position = -1;
+
+		gtk_editable_insert_text (GTK_EDITABLE (d->entry), d->keystrokes[i], -1, &position);
+
+		/* keep the entry at a realistic length */
+		if (i % 40 == 39)
+			gtk_entry_set_text (GTK_ENTRY (d->entry), "");
+	}
+}
+
+/*****************************************************************************/
+
+enum {
+	COL_ADDRESS,
+	COL_PREFIX,
+	COL_NEXT_HOP,
+	COL_METRIC,
+	N_COLUMNS
+};
+
+static GtkTreeModel *
+make_routes (GRand *rand, guint n)
+{
+	GtkListStore *store;
+	guint i;
+
+	store = gtk_list_store_new (N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+
+	for (i = 0; i < n; i++) {
+		GtkTreeIter iter;
+		gs_free char *address = NULL;
+		gs_free char *prefix = NULL;
+		gs_free char *next_hop = NULL;
+		gs_free char *metric = NULL;
+
+		address = g_strdup_printf ("10.%u.%u.0", (i >> 8) & 0xff, i & 0xff);
+		/* the prefix column takes either a prefix length or a netmask */
+		prefix = (i % 3) ? g_strdup_printf ("%u", 16 + i % 17) : g_strdup ("255.255.255.0");
+		next_hop = g_strdup_printf ("192.168.%u.%u", g_rand_int_range (rand, 0, 256), g_rand_int_range (rand, 1, 255));
+		metric = (i % 5) ? g_strdup_printf ("%u", g_rand_int_range (rand, 0, 1000)) : g_strdup ("");
+
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter,
+		                    COL_ADDRESS, address,
+		                    COL_PREFIX, prefix,
+		                    COL_NEXT_HOP, next_hop,
+		                    COL_METRIC, metric,
+		                    -1);
+	}
+
+	return GTK_TREE_MODEL (store);
+}
+
+static void
+bench_tree_model_get (gpointer data, guint n_items)
+{
+	GtkTreeModel *model = data;
+	GtkTreeIter iter;
+	gboolean valid;
+
+	for (valid = gtk_tree_model_get_iter_first (model, &iter);
+	     valid;
+	     valid = gtk_tree_model_iter_next (model, &iter)) {
+		gs_free char *address = NULL;
+		gs_free char *next_hop = NULL;
+		guint32 prefix;
+		gint64 metric = -1;
+
+		utils_tree_model_get_address (model, &iter, COL_ADDRESS, AF_INET, TRUE, &address, NULL);
+		utils_tree_model_get_ip4_prefix (model, &iter, COL_PREFIX, TRUE, &prefix, NULL);
+		utils_tree_model_get_address (model, &iter, COL_NEXT_HOP, AF_INET, FALSE, &next_hop, NULL);
+		utils_tree_model_get_int64 (model, &iter, COL_METRIC, 0, G_MAXUINT32, FALSE, &metric, NULL);
+	}
+}
+
+/*****************************************************************************/
+
+int
+main (int argc, char **argv)
+{
+	GRand *rand = g_rand_new_with_seed (42);
+	gboolean have_display;
+	ApData *aps;
+	char **bodies;
+	GtkTreeModel *routes;
+	guint i;
+
+	have_display = gtk_init_check (&argc, &argv);
+
+	aps = make_aps (rand, N_SSIDS);
+	bench_run ("utils_hash_ap", bench_hash_ap, aps, N_SSIDS);
+	for (i = 0; i < N_SSIDS; i++)
+		g_bytes_unref (aps[i].ssid);
+	g_free (aps);
+
+	bodies = make_bodies (rand, N_BODIES);
+	bench_run ("utils_escape_notify_body", bench_escape_notify_body, bodies, N_BODIES);
+	g_strfreev (bodies);
+
+	if (have_display) {
+		FilterData filter = { NULL };
+
+		filter.entry = g_object_ref_sink (gtk_entry_new ());
+		filter.keystrokes = make_keystrokes (rand, N_KEYSTROKES);
+		g_signal_connect (filter.entry, "insert-text", G_CALLBACK (address_filter_cb), NULL);
+
+		bench_run ("utils_filter_editable_on_insert_text", bench_filter_editable, &filter, N_KEYSTROKES);
+
+		g_strfreev (filter.keystrokes);
+		gtk_widget_destroy (filter.entry);
+		g_object_unref (filter.entry);
+	} else
+		g_printerr ("No display, skipping utils_filter_editable_on_insert_text\n");
+
+	routes = make_routes (rand, N_ROUTES);
+	bench_run ("utils_tree_model_get", bench_tree_model_get, routes, N_ROUTES);
+	g_object_unref (routes);
+
+	g_rand_free (rand);
+	return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include "nm-default.h"
 
 #include <string.h>
+#include <arpa/inet.h>
 
 #include "utils.h"
 
@@ -397,6 +398,108 @@ test_ap_hash_foobar_asdf11_adhoc_wpa_rsn (TestData *d)
 	g_assert (strcmp (d->foobar_adhoc_wpa_rsn, d->asdf11_adhoc_wpa_rsn));
 }
 
+static NMConnection *
+create_connection_with_routes (guint n_routes)
+{
+	NMConnection *connection;
+	NMSetting *setting;
+	NMIPRoute *route;
+	char dest[INET_ADDRSTRLEN];
+	GError *error = NULL;
+	guint i;
+
+	connection = nm_simple_connection_new ();
+
+	setting = nm_setting_connection_new ();
+	g_object_set (setting,
+	              NM_SETTING_CONNECTION_ID, "test",
+	              NM_SETTING_CONNECTION_UUID, "6a8a1a5b-4bce-47ee-a0e7-0c6e3b4d9a3e",
+	              NM_SETTING_CONNECTION_TYPE, NM_SETTING_WIRELESS_SETTING_NAME,
+	              NULL);
+	nm_connection_add_setting (connection, setting);
+
+	setting = nm_setting_wireless_security_new ();
+	g_object_set (setting,
+	              NM_SETTING_WIRELESS_SECURITY_KEY_MGMT, "wpa-eap",
+	              NM_SETTING_WIRELESS_SECURITY_PSK, "wifi-secret",
+	              NULL);
+	nm_connection_add_setting (connection, setting);
+
+	setting = nm_setting_802_1x_new ();
+	g_object_set (setting,
+	              NM_SETTING_802_1X_IDENTITY, "user",
+	              NM_SETTING_802_1X_PASSWORD, "eap-secret",
+	              NULL);
+	nm_connection_add_setting (connection, setting);
+
+	setting = nm_setting_ip4_config_new ();
+	g_object_set (setting,
+	              NM_SETTING_IP_CONFIG_METHOD, NM_SETTING_IP4_CONFIG_METHOD_AUTO,
+	              NULL);
+	for (i = 0; i < n_routes; i++) {
+		g_snprintf (dest, sizeof (dest), "10.%u.%u.0", (i >> 8) & 0xff, i & 0xff);
+		route = nm_ip_route_new (AF_INET, dest, 24, "192.168.1.1", 100, &error);
+		g_assert_no_error (error);
+		nm_setting_ip_config_add_route (NM_SETTING_IP_CONFIG (setting), route);
+		nm_ip_route_unref (route);
+	}
+	nm_connection_add_setting (connection, setting);
+
+	return connection;
+}
+
+static void
+test_secrets_to_dbus (void)
+{
+	gs_unref_object NMConnection *connection = NULL;
+	gs_unref_variant GVariant *all = NULL;
+	gs_unref_variant GVariant *secrets = NULL;
+	gs_unref_variant GVariant *setting = NULL;
+	const char *value;
+	gint64 t;
+
+	connection = create_connection_with_routes (5000);
+
+	t = g_get_monotonic_time ();
+	all = g_variant_ref_sink (nm_connection_to_dbus (connection, NM_CONNECTION_SERIALIZE_ALL));
+	/* Serialize it, as sending it over D-Bus would */
+	g_variant_get_size (all);
+	g_test_message ("whole connection: %" G_GSIZE_FORMAT " bytes in %" G_GINT64_FORMAT " us",
+	                g_variant_get_size (all), g_get_monotonic_time () - t);
+
+	t = g_get_monotonic_time ();
+	secrets = g_variant_ref_sink (utils_connection_secrets_to_dbus (connection,
+	                                                               NM_SETTING_WIRELESS_SECURITY_SETTING_NAME,
+	                                                               NULL));
+	g_variant_get_size (secrets);
+	g_test_message ("wireless-security secrets: %" G_GSIZE_FORMAT " bytes in %" G_GINT64_FORMAT " us",
+	                g_variant_get_size (secrets), g_get_monotonic_time () - t);
+
+	g_assert_cmpint (g_variant_n_children (secrets), ==, 1);
+	g_assert_cmpint (g_variant_get_size (secrets) * 100, <, g_variant_get_size (all));
+
+	setting = g_variant_lookup_value (secrets, NM_SETTING_WIRELESS_SECURITY_SETTING_NAME,
+	                                  NM_VARIANT_TYPE_SETTING);
+	g_assert (setting);
+	g_assert (g_variant_lookup (setting, NM_SETTING_WIRELESS_SECURITY_PSK, "&s", &value));
+	g_assert_cmpstr (value, ==, "wifi-secret");
+	g_assert (!g_variant_lookup (setting, NM_SETTING_WIRELESS_SECURITY_KEY_MGMT, "&s", &value));
+	g_clear_pointer (&setting, g_variant_unref);
+	g_clear_pointer (&secrets, g_variant_unref);
+
+	/* Missing settings are skipped */
+	secrets = g_variant_ref_sink (utils_connection_secrets_to_dbus (connection,
+	                                                               NM_SETTING_802_1X_SETTING_NAME,
+	                                                               NM_SETTING_PPPOE_SETTING_NAME,
+	                                                               NULL));
+	g_assert_cmpint (g_variant_n_children (secrets), ==, 1);
+	setting = g_variant_lookup_value (secrets, NM_SETTING_802_1X_SETTING_NAME,
+	                                  NM_VARIANT_TYPE_SETTING);
+	g_assert (setting);
+	g_assert (g_variant_lookup (setting, NM_SETTING_802_1X_PASSWORD, "&s", &value));
+	g_assert_cmpstr (value, ==, "eap-secret");
+}
+
 NMTST_DEFINE ();
 
 int
@@ -488,6 +591,8 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/ap_hash/foobar_asdf11/adhoc_wpa_rsn", data,
 	                      (GTestDataFunc) test_ap_hash_foobar_asdf11_adhoc_wpa_rsn);
 
+	g_test_add_func ("/secrets/to_dbus", test_secrets_to_dbus);
+
 	result = g_test_run ();
 
 	test_data_free (data);
@@ -160,6 +160,45 @@ utils_create_mobile_connection_id (const char *provider, const char *plan_name)
 	return g_strdup_printf (_("%s connection"), provider);
 }
 
+/**
+ * utils_connection_secrets_to_dbus:
+ * @connection: the connection
+ * @setting_name: the first setting whose secrets to return
+ * @...: more setting names, terminated by %NULL
+ *
+ * Like nm_connection_to_dbus() with %NM_CONNECTION_SERIALIZE_ONLY_SECRETS, but
+ * only serializes the given settings.  Settings the connection doesn't have
+ * are skipped.
+ *
+ * Returns: (transfer full): a floating a{sa{sv}}
+ */
+GVariant *
+utils_connection_secrets_to_dbus (NMConnection *connection,
+                                  const char *setting_name,
+                                  ...)
+{
+	gs_unref_object NMConnection *partial = NULL;
+	NMSetting *setting;
+	va_list ap;
+
+	g_return_val_if_fail (NM_IS_CONNECTION (connection), NULL);
+
+	/* Serializing the whole connection just to throw all but a setting or
+	 * two away again is expensive for connections with many routes,
+	 * addresses or peers.
+	 */
+	partial = nm_simple_connection_new ();
+	va_start (ap, setting_name);
+	for (; setting_name; setting_name = va_arg (ap, const char *)) {
+		setting = nm_connection_get_setting_by_name (connection, setting_name);
+		if (setting)
+			nm_connection_add_setting (partial, nm_setting_duplicate (setting));
+	}
+	va_end (ap);
+
+	return nm_connection_to_dbus (partial, NM_CONNECTION_SERIALIZE_ONLY_SECRETS);
+}
+
 void
 utils_show_error_dialog (const char *title,
                          const char *text1,
@@ -24,6 +24,10 @@ char *utils_escape_notify_body (const char *src);
 char *utils_create_mobile_connection_id (const char *provider,
                                          const char *plan_name);
 
+GVariant *utils_connection_secrets_to_dbus (NMConnection *connection,
+                                            const char *setting_name,
+                                            ...) G_GNUC_NULL_TERMINATED;
+
 void utils_show_error_dialog (const char *title,
                               const char *text1,
                               const char *text2,